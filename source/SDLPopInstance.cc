@@ -1,16 +1,30 @@
 #include "SDLPopInstance.h"
+#include "hash.h"
 #include "types.h"
 #include "utils.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <iostream>
+#include <link.h>
+#include <mutex>
 #include <omp.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 char *__prince_argv[] = {(char *)"prince"};
 const char* seqNames[] = {"running", "startrun", "runstt1", "runstt4", "runcyc1", "runcyc7", "stand", "goalertstand", "alertstand", "arise", "guardengarde", "engarde", "ready", "ready_loop", "stabbed", "strikeadv", "strikeret", "advance", "fastadvance", "retreat", "strike", "faststrike", "guy4", "guy7", "guy8", "blockedstrike", "blocktostrike", "readyblock", "blocking", "striketoblock", "landengarde", "bumpengfwd", "bumpengback", "flee", "turnengarde", "alertturn", "standjump", "sjland", "runjump", "rjlandrun", "rdiveroll", "rdiveroll_crouch", "sdiveroll", "crawl", "crawl_crouch", "turndraw", "turn", "turnrun", "runturn", "fightfall", "efightfall", "efightfallfwd", "stepfall", "fall1", "patchfall", "stepfall2", "stepfloat", "jumpfall", "rjumpfall", "jumphangMed", "jumphangLong", "jumpbackhang", "hang", "hang1", "hangstraight", "hangstraight_loop", "climbfail", "climbdown", "climbup", "hangdrop", "hangfall", "freefall", "freefall_loop", "runstop", "jumpup", "highjump", "superhijump", "fallhang", "bump", "bumpfall", "bumpfloat", "hardbump", "testfoot", "stepback", "step14", "step13", "step12", "step11", "step10", "step10a", "step9", "step8", "step7", "step6", "step5", "step4", "step3", "step2", "step1", "stoop", "stoop_crouch", "standup", "pickupsword", "resheathe", "fastsheathe", "drinkpotion", "softland", "softland_crouch", "landrun", "medland", "hardland", "hardland_dead", "stabkill", "dropdead", "dropdead_dead", "impale", "impale_dead", "halve", "halve_dead", "crush", "deadfall", "deadfall_loop", "climbstairs", "climbstairs_loop", "Vstand", "Vraise", "Vraise_loop", "Vwalk", "Vwalk1", "Vwalk2", "Vstop", "Vexit", "Pstand", "Palert", "Pstepback", "Pstepback_loop", "Plie", "Pwaiting", "Pembrace", "Pembrace_loop", "Pstroke", "Prise", "Prise_loop", "Pcrouch", "Pcrouch_loop", "Pslump", "Pslump_loop", "Mscurry", "Mscurry1", "Mstop", "Mraise", "Mleave", "Mclimb", "unrecognized" };
 const word seqOffsets[] = { 0x1973, 0x1975, 0x1978, 0x1981, 0x1995, 0x19A0, 0x19A6, 0x19A8, 0x19AC, 0x19C1, 0x19C4, 0x19D2, 0x19D8, 0x19DC, 0x19F9, 0x1A07, 0x1A13, 0x1A22, 0x1A2E, 0x1A3C, 0x1A42, 0x1A45, 0x1A4A, 0x1A4D, 0x1A54, 0x1A5A, 0x1A5E, 0x1A5F, 0x1A63, 0x1A68, 0x1A6E, 0x1A75, 0x1A7C, 0x1A83, 0x1A8B, 0x1A93, 0x1AB0, 0x1ACD, 0x1AFB, 0x1B04, 0x1B16, 0x1B1A, 0x1B1B, 0x1B29, 0x1B2D, 0x1B39, 0x1B53, 0x1B5A, 0x1B85, 0x1BA1, 0x1BBF, 0x1BDB, 0x1BE4, 0x1BFA, 0x1C01, 0x1C06, 0x1C1C, 0x1C38, 0x1C54, 0x1C69, 0x1C84, 0x1CA1, 0x1CA4, 0x1CD1, 0x1CD8, 0x1CDC, 0x1CEC, 0x1D04, 0x1D25, 0x1D36, 0x1D49, 0x1D4B, 0x1D4F, 0x1D68, 0x1D7D, 0x1D9B, 0x1DF6, 0x1DFC, 0x1E06, 0x1E25, 0x1E3B, 0x1E59, 0x1E78, 0x1E7D, 0x1E9C, 0x1EBB, 0x1EDA, 0x1EF7, 0x1EFC, 0x1F13, 0x1F19, 0x1F33, 0x1F48, 0x1F5D, 0x1F72, 0x1F82, 0x1F92, 0x1F9E, 0x1FA7, 0x1FAF, 0x1FB3, 0x1FCA, 0x1FDA, 0x1FFB, 0x2009, 0x202B, 0x2036, 0x203A, 0x205A, 0x209C, 0x20A5, 0x20A9, 0x20AE, 0x20BA, 0x20BE, 0x20C5, 0x20C9, 0x20CD, 0x20D1, 0x20D4, 0x20D9, 0x20DD, 0x212E, 0x2132, 0x2136, 0x214B, 0x214F, 0x2151, 0x2154, 0x2166, 0x216D, 0x2195, 0x2199, 0x21A8, 0x21B8, 0x21BC, 0x21C0, 0x21C4, 0x21E2, 0x21E6, 0x21EA, 0x21F8, 0x21FC, 0x223C, 0x2240, 0x2241, 0x2245, 0x2247, 0x2253, 0x2257, 0x225B, 0x226E, 0x2270 };
 
-void SDLPopInstance::initialize(const bool useGUI)
+void SDLPopInstance::initialize(const bool useGUI, const bool simulationOnly)
 {
+ if (useGUI && simulationOnly) EXIT_WITH_ERROR("[Error] Simulation-only SDLPop instances cannot use GUI.\n");
+ _isSimulationOnly = simulationOnly;
+
  _IGTMins = 0;
  _IGTSecs = 0;
  _IGTMillisecs = 0;
@@ -71,6 +85,10 @@ void SDLPopInstance::initialize(const bool useGUI)
   *g_argc = 1;
   *g_argv = __prince_argv;
 
+  // Resuming from a warm-start image, if one is given and matches this library and game files
+  const char *warmStartImage = std::getenv("JAFFAR_WARM_START_IMAGE");
+  if (useGUI == false && warmStartImage != NULL && loadWarmStartImage(warmStartImage)) return;
+
   // Fix feather fall problem when quickload/quicksaving
   init_copyprot();
   (*fixes)->fix_quicksave_during_feather = 1;
@@ -138,7 +156,7 @@ void SDLPopInstance::initialize(const bool useGUI)
   (*chtab_addrs)[id_chtab_1_flameswordpotion] = load_sprites_from_file(150, 1 << 3, 1);
 
   close_dat(*dathandle);
-  load_all_sounds();
+  if (_isSimulationOnly == false) load_all_sounds();
   hof_read();
 
   ///////////////////////////////////////////////////
@@ -162,10 +180,13 @@ void SDLPopInstance::initialize(const bool useGUI)
   *rem_min = (*custom)->start_minutes_left; // 60
   *rem_tick = (*custom)->start_ticks_left;  // 719
   *hitp_beg_lev = (*custom)->start_hitp;    // 3
+  buildLevelCache();
   *current_level = 0;
   startLevel(1);
   *need_level1_music = (*custom)->intro_music_time_initial;
 
+  // Storing the initialized state for the next processes to resume from
+  if (useGUI == false && warmStartImage != NULL) saveWarmStartImage(warmStartImage);
 
   if (useGUI == true)
   {
@@ -218,10 +239,13 @@ void SDLPopInstance::startLevel(const word level)
 {
  ///////////////////////////////////////////////////////////////
   // play_level
-  if (level != *current_level) load_lev_spr(level);
+  if (level != *current_level) loadLevelSprites(level);
 
   load_kid_sprite();
-  load_level();
+
+  // load_level() parses the level from the levels file every time, so its result is cached per level number
+  if (_useLevelCache == true) loadCachedLevel();
+  if (_useLevelCache == false) load_level();
   pos_guards();
   clear_coll_rooms();
   clear_saved_ctrl();
@@ -249,14 +273,20 @@ void SDLPopInstance::startLevel(const word level)
 
   find_start_level_door();
 
-  // busy waiting?
-  while (check_sound_playing() && !do_paused()) idle();
+  if (_isSimulationOnly == false)
+  {
+   // busy waiting?
+   while (check_sound_playing() && !do_paused()) idle();
+
+   stop_sounds();
 
-  stop_sounds();
+   restore_room_after_quick_load();
+   draw_level_first();
+  }
 
-  restore_room_after_quick_load();
-  draw_level_first();
+  if (_isSimulationOnly == true) restoreRoomWithoutDrawing();
 
+  // Only shows text on the copy protection level, which sets its timers
   show_copyprot(0);
   *enable_copyprot = 1;
   reset_timer(timer_1);
@@ -264,14 +294,76 @@ void SDLPopInstance::startLevel(const word level)
   _prevDrawnRoom = *drawn_room;
 
   set_timer_length(timer_1, 12);
-  // Setting exit door status
-  isExitDoorOpen = isLevelExitDoorOpen();
+  // Setting exit door status and the rest of the level features
+  updateLevelFeatures();
 
   if (*need_level1_music != 0 && *current_level == (*custom)->intro_music_level)
    if ((*fixes)->fix_quicksave_during_lvl1_music)
     *need_level1_music = (*custom)->intro_music_time_restart;
 }
 
+void SDLPopInstance::loadLevelSprites(const word levelId)
+{
+ const size_t chtabCount = sizeof(chtab_addrs_t) / sizeof(chtab_type *);
+
+ // Regular instances reload the level sprites anyway upon restore_room_after_quick_load()
+ if (_useLevelCache == false || _isSimulationOnly == false)
+ {
+  load_lev_spr(levelId);
+  return;
+ }
+
+ // Cached sprites are kept for the lifetime of the instance, so load_lev_spr must never free them
+ for (size_t i = id_chtab_3_princedungeon; i < chtabCount; i++) (*chtab_addrs)[i] = NULL;
+
+ auto it = _levelSprites.find(levelId);
+ if (it == _levelSprites.end())
+ {
+  load_lev_spr(levelId);
+  _levelSprites[levelId] = std::vector<chtab_type *>(&(*chtab_addrs)[0], &(*chtab_addrs)[chtabCount]);
+  return;
+ }
+
+ // Doing what load_lev_spr does, other than loading the sprites
+ for (size_t i = id_chtab_3_princedungeon; i < chtabCount; i++) (*chtab_addrs)[i] = it->second[i];
+ *current_level = levelId;
+ *next_level = levelId;
+}
+
+void SDLPopInstance::restoreRoomWithoutDrawing()
+{
+ // restore_room_after_quick_load(), minus reloading the level sprites (already loaded by startLevel) and drawing
+ const word guardColor = *curr_guard_color;
+ const word nextLevel = *next_level;
+ reset_level_unused_fields(false);
+ *curr_guard_color = guardColor;
+ *next_level = nextLevel;
+
+ *next_room = *drawn_room = Kid->room;
+ load_room_links();
+ *is_guard_notice = 0;
+
+ // draw_game_frame() would play (and clear) the next sound, which startLevel already cleared
+ *next_sound = -1;
+
+ *hitp_delta = 1;
+ *guardhp_delta = Guard->room == *drawn_room ? 1 : 0;
+ loadkid_and_opp();
+ *text_time_total = 0;
+ *text_time_remaining = 0;
+
+ // draw_level_first() finds the kid already in the drawn room, and redrawing the screen leaves
+ // the room marked as drawn and restarts the exit room timer
+ *different_room = 0;
+ *exit_room_timer = 2;
+}
+
+void SDLPopInstance::setLevelCache(const bool useLevelCache)
+{
+ if (useLevelCache == false && _contexts.empty() == false) EXIT_WITH_ERROR("[Error] The level cache cannot be disabled on an SDLPop instance with emulator contexts.\n");
+ _useLevelCache = useLevelCache;
+}
+
 void SDLPopInstance::setSeed(const dword randomSeed)
 {
   *random_seed = randomSeed;
@@ -375,7 +467,7 @@ std::string SDLPopInstance::serializeFileCache()
  return cache;
 }
 
-void SDLPopInstance::deserializeFileCache(const std::string& cache)
+void SDLPopInstance::deserializeFileCache(const std::string_view cache)
 {
  // Copying file counter
  size_t curPosition = 0;
@@ -402,50 +494,43 @@ void SDLPopInstance::deserializeFileCache(const std::string& cache)
  }
 }
 
-void SDLPopInstance::performMove(const std::string &move)
+// Key states written by every possible move: up, down, left, right and shift
+struct moveKeys_t
 {
-  (*key_states)[SDL_SCANCODE_UP] = 0;
-  (*key_states)[SDL_SCANCODE_DOWN] = 0;
-  (*key_states)[SDL_SCANCODE_LEFT] = 0;
-  (*key_states)[SDL_SCANCODE_RIGHT] = 0;
-  (*key_states)[SDL_SCANCODE_RSHIFT] = 0;
-
-  bool recognizedMove = false;
+  byte keys[5];
+};
 
-  if (move.find(".") != std::string::npos) { recognizedMove = true; }
-  if (move.find("R") != std::string::npos)
-  {
-    (*key_states)[SDL_SCANCODE_RIGHT] = 1;
-    recognizedMove = true;
-  }
-  if (move.find("L") != std::string::npos)
-  {
-    (*key_states)[SDL_SCANCODE_LEFT] = 1;
-    recognizedMove = true;
-  }
-  if (move.find("U") != std::string::npos)
-  {
-    (*key_states)[SDL_SCANCODE_UP] = 1;
-    recognizedMove = true;
-  }
-  if (move.find("D") != std::string::npos)
-  {
-    (*key_states)[SDL_SCANCODE_DOWN] = 1;
-    recognizedMove = true;
-  }
-  if (move.find("S") != std::string::npos)
-  {
-    (*key_states)[SDL_SCANCODE_RSHIFT] = 1;
-    recognizedMove = true;
-  }
-  if (move == "CA") // Ctrl+A
+static constexpr std::array<moveKeys_t, _MOVE_COUNT> getMoveKeyTable()
+{
+  std::array<moveKeys_t, _MOVE_COUNT> table{};
+  for (size_t move = 0; move < _MOVE_COUNT; move++)
   {
-    *is_restart_level = 1;
-    recognizedMove = true;
+    table[move].keys[0] = (move & MOVE_UP) != 0;
+    table[move].keys[1] = (move & MOVE_DOWN) != 0;
+    table[move].keys[2] = (move & MOVE_LEFT) != 0;
+    table[move].keys[3] = (move & MOVE_RIGHT) != 0;
+    table[move].keys[4] = (move & MOVE_SHIFT) != 0;
   }
+  return table;
+}
+
+static constexpr auto _moveKeyTable = getMoveKeyTable();
 
-  if (recognizedMove == false)
-    EXIT_WITH_ERROR("[Error] Unrecognized move: %s\n", move.c_str());
+void SDLPopInstance::performMove(const Move move)
+{
+  const auto &moveKeys = _moveKeyTable[move % _MOVE_COUNT];
+  (*key_states)[SDL_SCANCODE_UP] = moveKeys.keys[0];
+  (*key_states)[SDL_SCANCODE_DOWN] = moveKeys.keys[1];
+  (*key_states)[SDL_SCANCODE_LEFT] = moveKeys.keys[2];
+  (*key_states)[SDL_SCANCODE_RIGHT] = moveKeys.keys[3];
+  (*key_states)[SDL_SCANCODE_RSHIFT] = moveKeys.keys[4];
+
+  if (move & MOVE_RESTART) *is_restart_level = 1;
+}
+
+void SDLPopInstance::performMove(const std::string &move)
+{
+  performMove(parseMove(move));
 }
 
 dword SDLPopInstance::advanceRNGState(const dword randomSeed)
@@ -458,6 +543,61 @@ dword SDLPopInstance::reverseRNGState(const dword randomSeed)
  return (randomSeed + 4292436285) * 3115528533;
 }
 
+// SDLPop's generator is the affine map x -> a*x + c modulo 2^32
+#define _RNG_MULTIPLIER 214013u
+#define _RNG_INCREMENT 2531011u
+
+dword SDLPopInstance::advanceRNGState(const dword randomSeed, const uint64_t steps)
+{
+ // Composing the affine map with itself by squaring, accumulating the powers that make up the step count
+ dword accMultiplier = 1;
+ dword accIncrement = 0;
+ dword curMultiplier = _RNG_MULTIPLIER;
+ dword curIncrement = _RNG_INCREMENT;
+
+ for (uint64_t delta = steps; delta > 0; delta >>= 1)
+ {
+  if (delta & 1)
+  {
+   accMultiplier = accMultiplier * curMultiplier;
+   accIncrement = accIncrement * curMultiplier + curIncrement;
+  }
+  curIncrement = (curMultiplier + 1) * curIncrement;
+  curMultiplier = curMultiplier * curMultiplier;
+ }
+
+ return accMultiplier * randomSeed + accIncrement;
+}
+
+dword SDLPopInstance::reverseRNGState(const dword randomSeed, const uint64_t steps)
+{
+ // The period is 2^32, so going back k steps is the same as going forward 2^32 - k
+ return advanceRNGState(randomSeed, (0x100000000ull - (steps & 0xFFFFFFFFull)) & 0xFFFFFFFFull);
+}
+
+dword SDLPopInstance::getRNGDistance(const dword initialSeed, const dword targetSeed)
+{
+ // Fixing the distance one bit at a time, from the lowest: bit i of the state only depends on
+ // the lowest i+1 bits of the step count, and a 2^i step jump flips it while keeping the lower ones
+ dword seed = initialSeed;
+ dword distance = 0;
+ dword curMultiplier = _RNG_MULTIPLIER;
+ dword curIncrement = _RNG_INCREMENT;
+
+ for (dword bit = 1; seed != targetSeed; bit <<= 1)
+ {
+  if ((seed & bit) != (targetSeed & bit))
+  {
+   seed = seed * curMultiplier + curIncrement;
+   distance |= bit;
+  }
+  curIncrement = (curMultiplier + 1) * curIncrement;
+  curMultiplier = curMultiplier * curMultiplier;
+ }
+
+ return distance;
+}
+
 
 void SDLPopInstance::advanceFrame()
 {
@@ -467,8 +607,14 @@ void SDLPopInstance::advanceFrame()
 
   play_frame();
 
+  // Starting a level already updates the level features
+  bool isLevelStarted = false;
+
   if (*is_restart_level == 1)
+  {
    startLevel(*current_level);
+   isLevelStarted = true;
+  }
 
   // if we're on lvl 4, check mirror
   if (*current_level == 4)
@@ -490,31 +636,78 @@ void SDLPopInstance::advanceFrame()
    }
 
    startLevel(*next_level);
+   isLevelStarted = true;
 
    // Handle cutscenes
-   //if (*next_level == 2) for (size_t i = 0; i < 3; i++) *random_seed = advanceRNGState(*random_seed);
+   //if (*next_level == 2) *random_seed = advanceRNGState(*random_seed, 3);
   }
 
   *is_restart_level = 0;
   _prevDrawnRoom = *drawn_room;
-  isExitDoorOpen = isLevelExitDoorOpen();
+  if (isLevelStarted == false) updateLevelFeatures();
+}
+
+size_t SDLPopInstance::advanceFrames(const Move *moves, const size_t moveCount, const size_t frameInterval, const std::function<bool(const size_t)> &callback, const uint32_t triggers)
+{
+  byte prevRoom = Kid->room;
+  word prevLevel = *current_level;
+  word prevKidHP = *hitp_curr;
+  word prevGuardHP = *guardhp_curr;
+
+  for (size_t i = 0; i < moveCount; i++)
+  {
+    performMove(moves[i]);
+    advanceFrame();
+
+    bool isTriggered = i + 1 == moveCount || (frameInterval > 0 && (i + 1) % frameInterval == 0);
+
+    if (triggers != 0)
+    {
+      if ((triggers & TRIGGER_ROOM_CHANGE) && Kid->room != prevRoom) isTriggered = true;
+      if ((triggers & TRIGGER_LEVEL_CHANGE) && *current_level != prevLevel) isTriggered = true;
+      if ((triggers & TRIGGER_HP_CHANGE) && (*hitp_curr != prevKidHP || *guardhp_curr != prevGuardHP)) isTriggered = true;
+      prevRoom = Kid->room;
+      prevLevel = *current_level;
+      prevKidHP = *hitp_curr;
+      prevGuardHP = *guardhp_curr;
+    }
+
+    if (isTriggered && callback(i) == false) return i + 1;
+  }
+
+  return moveCount;
+}
+
+// Number of sequences with a known start offset, the last of which (Mclimb) runs until the end of the table
+#define _SEQUENCE_COUNT (sizeof(seqOffsets) / sizeof(word))
+#define _SEQUENCE_TABLE_END 0x2280
+#define _SEQUENCE_UNRECOGNIZED _SEQUENCE_COUNT
+
+int SDLPopInstance::getSequenceId(const word seqOffset)
+{
+  // Sequence id for every offset within the sequence table, built upon the first call
+  static const std::vector<uint8_t> sequenceIds = []() {
+    std::vector<uint8_t> ids(_SEQUENCE_TABLE_END - seqOffsets[0]);
+    for (size_t i = 0; i < _SEQUENCE_COUNT; i++)
+    {
+      const word end = i + 1 < _SEQUENCE_COUNT ? seqOffsets[i + 1] : _SEQUENCE_TABLE_END;
+      for (word offset = seqOffsets[i]; offset < end; offset++) ids[offset - seqOffsets[0]] = i;
+    }
+    return ids;
+  }();
+
+  if (seqOffset < seqOffsets[0] || seqOffset >= _SEQUENCE_TABLE_END) return _SEQUENCE_UNRECOGNIZED;
+  return sequenceIds[seqOffset - seqOffsets[0]];
 }
 
 int SDLPopInstance::getKidSequenceId()
 {
- int seqIdx = Kid->curr_seq;
- for (int i = 0; i < 113; i++)
-  if (seqIdx >= seqOffsets[i] && seqIdx < seqOffsets[i+1]) return i;
- return 153; // Unrecognized
+  return getSequenceId(Kid->curr_seq);
 }
 
 int SDLPopInstance::getGuardSequenceId()
 {
- int seqIdx = Guard->curr_seq;
- for (int i = 0; i < 113; i++)
-  if (seqIdx >= seqOffsets[i] && seqIdx < seqOffsets[i+1])
-   return i;
- return 153; // Unrecognized
+  return getSequenceId(Guard->curr_seq);
 }
 
 
@@ -528,7 +721,7 @@ void SDLPopInstance::printFrameInfo()
   printf("[Jaffar]  + [Kid]   Room: %d, Pos.x: %3d, Pos.y: %3d, Frame: %3d, HP: %d/%d, Sequence: %2d (%s)\n", int(Kid->room), int(Kid->x), int(Kid->y), int(Kid->frame), int(*hitp_curr), int(*hitp_max), kidSeqIdx, seqNames[kidSeqIdx]);
   printf("[Jaffar]  + [Guard] Room: %d, Pos.x: %3d, Pos.y: %3d, Frame: %3d, HP: %d/%d, Sequence: %2d (%s)\n", int(Guard->room), int(Guard->x), int(Guard->y), int(Guard->frame), int(*guardhp_curr), int(*guardhp_max), guardSeqIdx, seqNames[guardSeqIdx]);
   printf("[Jaffar]  + Exit Room Timer: %d\n", *exit_room_timer);
-  printf("[Jaffar]  + Exit Door Open: %s\n", isLevelExitDoorOpen() ? "Yes" : "No");
+  printf("[Jaffar]  + Exit Door Open: %s\n", _levelFeatures.isExitDoorOpen ? "Yes" : "No");
   printf("[Jaffar]  + Reached Checkpoint: %s\n", *checkpoint ? "Yes" : "No");
   printf("[Jaffar]  + Feather Fall: %d\n", *is_feather_fall);
   printf("[Jaffar]  + RNG State: 0x%08X (Last Loose Tile Sound Id: %d)\n", *random_seed, *last_loose_sound);
@@ -537,26 +730,855 @@ void SDLPopInstance::printFrameInfo()
   if (*current_level == 9) printf("[Jaffar]  + Rightmost Door: %d\n", level->bg[349]);
 }
 
-bool SDLPopInstance::isLevelExitDoorOpen()
+void SDLPopInstance::updateLevelFeatures()
+{
+ // Gates never appear during a level, and loose tiles can only disappear, so their candidate positions
+ // only need to be taken from the pristine level upon a level change. Level numbers outside the levels
+ // file (e.g., from a corrupted state) have no pristine level, and so no gates or loose tiles
+ if (_featureLevel != *current_level)
+ {
+  _featureLevel = *current_level;
+  _gateTiles.clear();
+  _looseTileCandidates.clear();
+
+  const auto it = _pristineLevels.find(*current_level);
+  if (it != _pristineLevels.end())
+   for (word i = 0; i < sizeof(it->second.fg); i++)
+   {
+    const auto type = it->second.fg[i] & 0x1f;
+    if (type == tiles_4_gate) _gateTiles.push_back(i);
+    if (type == tiles_11_loose) _looseTileCandidates.push_back(i);
+   }
+ }
+
+ // Exit door and active gates are found in a single pass over the active objects
+ _levelFeatures.isExitDoorOpen = *leveldoor_open;
+ _levelFeatures.gates.resize(_gateTiles.size());
+ for (size_t i = 0; i < _gateTiles.size(); i++) _levelFeatures.gates[i] = {_gateTiles[i], level->bg[_gateTiles[i]], false};
+
+ for (int i = 0; i < *trobs_count; ++i)
+ {
+  const auto &trob = (*trobs)[i];
+  const auto idx = (trob.room - 1) * 30 + trob.tilepos;
+  const auto type = level->fg[idx] & 0x1f;
+  if (type == tiles_16_level_door_left) _levelFeatures.isExitDoorOpen = true;
+  if (type == tiles_4_gate)
+   for (auto &gate : _levelFeatures.gates)
+    if (gate.tileIdx == idx) gate.isActive = true;
+ }
+
+ _levelFeatures.looseTiles.clear();
+ for (const auto idx : _looseTileCandidates)
+  if ((level->fg[idx] & 0x1f) == tiles_11_loose) _levelFeatures.looseTiles.push_back(idx);
+}
+
+// Level numbers in the levels file, including the demo (0) and copy protection (15) levels
+#define _LEVEL_COUNT 16
+
+void SDLPopInstance::buildLevelCache()
+{
+ // load_level() works on the live globals, so the writable sdlPopLib memory is put back afterwards. The only
+ // heap memory it uses is the levels file handle, which it closes again
+ const auto segments = getWritableSegments();
+ std::vector<std::string> segmentBackups;
+ for (const auto &segment : segments) segmentBackups.emplace_back(segment.ptr, segment.size);
+
+ _pristineLevels.clear();
+ for (word levelId = 0; levelId < _LEVEL_COUNT; levelId++)
+ {
+  *current_level = levelId;
+  load_level();
+  _pristineLevels[levelId] = *level;
+ }
+
+ // Keeping the levels file in the file cache, if it was just added to it, so its buffer is not lost
+ std::string fileCache;
+ fileCache.append((const char *)_cachedFileCounter, sizeof(*_cachedFileCounter));
+ fileCache.append((const char *)_cachedFilePointerTable, sizeof(*_cachedFilePointerTable));
+ fileCache.append((const char *)_cachedFileBufferTable, sizeof(*_cachedFileBufferTable));
+ fileCache.append((const char *)_cachedFileBufferSizes, sizeof(*_cachedFileBufferSizes));
+ fileCache.append((const char *)_cachedFilePathTable, sizeof(*_cachedFilePathTable));
+
+ for (size_t i = 0; i < segments.size(); i++) memcpy(segments[i].ptr, segmentBackups[i].data(), segments[i].size);
+
+ size_t pos = 0;
+ memcpy(_cachedFileCounter, &fileCache[pos], sizeof(*_cachedFileCounter)); pos += sizeof(*_cachedFileCounter);
+ memcpy(_cachedFilePointerTable, &fileCache[pos], sizeof(*_cachedFilePointerTable)); pos += sizeof(*_cachedFilePointerTable);
+ memcpy(_cachedFileBufferTable, &fileCache[pos], sizeof(*_cachedFileBufferTable)); pos += sizeof(*_cachedFileBufferTable);
+ memcpy(_cachedFileBufferSizes, &fileCache[pos], sizeof(*_cachedFileBufferSizes)); pos += sizeof(*_cachedFileBufferSizes);
+ memcpy(_cachedFilePathTable, &fileCache[pos], sizeof(*_cachedFilePathTable));
+}
+
+const level_type &SDLPopInstance::getPristineLevel(const word levelId) const
+{
+ const auto it = _pristineLevels.find(levelId);
+ if (it == _pristineLevels.end()) EXIT_WITH_ERROR("[Error] Level %u is not in the level cache.\n", levelId);
+ return it->second;
+}
+
+void SDLPopInstance::loadCachedLevel()
+{
+ *level = getPristineLevel(*current_level);
+
+ // alter_mods_allrm() leaves the last used room as the loaded one, along with its left and right links
+ const word lastRoom = level->used_rooms;
+ if (lastRoom == 0) return;
+ get_room_address(lastRoom);
+ *room_L = level->roomlinks[lastRoom - 1].left;
+ *room_R = level->roomlinks[lastRoom - 1].right;
+}
+
+// Block size for comparisons upon rollback
+#define _ROLLBACK_BLOCK_SIZE 64
+
+void SDLPopInstance::addRollbackRegion(void *ptr, const size_t size)
 {
-  bool door_open = *leveldoor_open;
+  // Regions registered more than once (e.g., by several state handlers) are only stored once
+  for (const auto &region : _rollbackRegions)
+    if (region.ptr == ptr && region.size == size) return;
+
+  _rollbackRegions.push_back({(char *)ptr, size, _rollbackData.size()});
+  _rollbackData.resize(_rollbackData.size() + size);
+}
 
-  if (!door_open)
+void SDLPopInstance::setRollbackPoint()
+{
+  for (const auto &region : _rollbackRegions) memcpy(&_rollbackData[region.offset], region.ptr, region.size);
+  memcpy(_rollbackRoomLinks, level->roomlinks, sizeof(_rollbackRoomLinks));
+}
+
+void SDLPopInstance::rollback()
+{
+  const word prevDrawnRoom = *drawn_room;
+  const bool roomLinksChanged = memcmp(level->roomlinks, _rollbackRoomLinks, sizeof(_rollbackRoomLinks)) != 0;
+
+  // Only undoing the blocks that were written since the rollback point
+  for (const auto &region : _rollbackRegions)
+    for (size_t pos = 0; pos < region.size; pos += _ROLLBACK_BLOCK_SIZE)
+    {
+      const size_t blockSize = std::min((size_t)_ROLLBACK_BLOCK_SIZE, region.size - pos);
+      const char *src = &_rollbackData[region.offset + pos];
+      if (memcmp(region.ptr + pos, src, blockSize) != 0) memcpy(region.ptr + pos, src, blockSize);
+    }
+
+  finishStateLoad(prevDrawnRoom, roomLinksChanged);
+}
+
+void SDLPopInstance::finishStateLoad(const word prevDrawnRoom, const bool roomLinksChanged)
+{
+  updateLevelFeatures();
+  *different_room = 1;
+  // Show the room where the prince is, even if the player moved the view away
+  // from it (with the H,J,U,N keys).
+  *next_room = *drawn_room = Kid->room;
+
+  // Room links only depend on the drawn room and the level layout. Loading them also points the current room
+  // tiles to the drawn room, which the game moves to other rooms while processing a frame
+  if (roomLinksChanged || prevDrawnRoom != *drawn_room || *loaded_room != *drawn_room) load_room_links();
+}
+
+// Names of the bound symbols, in table order
+#define SDLPOP_SYMBOL_NAME(TYPE, NAME) #NAME,
+static const char *_symbolNames[] = {SDLPOP_SYMBOLS(SDLPOP_SYMBOL_NAME)};
+#undef SDLPOP_SYMBOL_NAME
+
+static constexpr size_t _symbolCount = sizeof(_symbolNames) / sizeof(_symbolNames[0]);
+
+// Location of a symbol: its offset from the library load base or, for symbols that resolve
+// to another object (e.g., a dependency), a marker to look them up again in every namespace
+struct symbolLocation_t
+{
+  ptrdiff_t offset;
+  bool external;
+};
+
+// Symbol locations per library file, resolved by the first instance that loads it
+static std::map<std::string, std::vector<symbolLocation_t>> _symbolTables;
+static std::mutex _symbolTablesMutex;
+
+void SDLPopInstance::bindSymbols()
+{
+  struct link_map *linkMap;
+  if (dlinfo(_dllHandle, RTLD_DI_LINKMAP, &linkMap) != 0) EXIT_WITH_ERROR("[Error] Could not get the link map of the sdlPopLib: %s\n", dlerror());
+  const uintptr_t base = linkMap->l_addr;
+
+  std::vector<symbolLocation_t> *symbolTable;
   {
-    for (int i = 0; i < *trobs_count; ++i)
+    std::lock_guard<std::mutex> lock(_symbolTablesMutex);
+    symbolTable = &_symbolTables[linkMap->l_name];
+
+    // Resolving all symbols the first time this library is loaded, reporting every missing one at once
+    if (symbolTable->empty())
     {
-      const auto &trob = (*trobs)[i];
-      const auto idx = (trob.room - 1) * 30 + trob.tilepos;
-      const auto type = level->fg[idx] & 0x1f;
-      if (type == tiles_16_level_door_left)
+      std::string missingSymbols;
+      for (size_t i = 0; i < _symbolCount; i++)
       {
-        door_open = true;
-        break;
+        void *address = dlsym(_dllHandle, _symbolNames[i]);
+        if (address == NULL)
+        {
+          missingSymbols += std::string(" ") + _symbolNames[i];
+          continue;
+        }
+
+        Dl_info info;
+        struct link_map *symbolMap = NULL;
+        dladdr1(address, &info, (void **)&symbolMap, RTLD_DL_LINKMAP);
+        symbolTable->push_back({(ptrdiff_t)((uintptr_t)address - base), symbolMap != linkMap});
+      }
+
+      if (missingSymbols.empty() == false)
+      {
+        symbolTable->clear();
+        EXIT_WITH_ERROR("[Error] Missing symbols in %s:%s\n", linkMap->l_name, missingSymbols.c_str());
       }
     }
   }
 
-  return door_open;
+  // Rebasing the symbol offsets for this namespace
+  size_t symbolIdx = 0;
+  #define SDLPOP_BIND_SYMBOL(TYPE, NAME)                                                               \
+  {                                                                                                    \
+    const auto &location = (*symbolTable)[symbolIdx++];                                                \
+    NAME = (TYPE)(location.external ? dlsym(_dllHandle, #NAME) : (void *)(base + location.offset)); \
+  }
+  SDLPOP_SYMBOLS(SDLPOP_BIND_SYMBOL)
+  #undef SDLPOP_BIND_SYMBOL
+}
+
+// Object loaded in a library namespace: its load base, its full extent and its writable parts
+struct loadedObject_t
+{
+  std::string name;
+  uintptr_t base;
+  uintptr_t start;
+  uintptr_t end;
+  std::vector<SDLPopInstance::segment_t> writableSegments;
+  std::string buildId;
+};
+
+// Looks for the GNU build ID among the notes of a loaded object
+static void readBuildId(const char *notes, const size_t size, std::string &buildId)
+{
+ size_t pos = 0;
+ while (pos + sizeof(ElfW(Nhdr)) <= size)
+ {
+  const auto nhdr = (const ElfW(Nhdr) *)(notes + pos);
+  const size_t nameOffset = pos + sizeof(ElfW(Nhdr));
+  const size_t descOffset = nameOffset + ((nhdr->n_namesz + 3) & ~3);
+  if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 && memcmp(notes + nameOffset, "GNU", 4) == 0)
+  {
+   buildId.assign(notes + descOffset, nhdr->n_descsz);
+   return;
+  }
+  pos = descOffset + ((nhdr->n_descsz + 3) & ~3);
+ }
+}
+
+// Reads the program headers of a loaded object. dl_iterate_phdr only reports the objects of the caller's
+// namespace, so they are taken from the ELF header mapped at the object's base address instead
+static bool readLoadedObject(const struct link_map *linkMap, loadedObject_t &object)
+{
+ // Objects not loaded at a relocated address (e.g., a non-PIE executable) are not namespace-specific
+ if (linkMap->l_addr == 0) return false;
+
+ const auto ehdr = (const ElfW(Ehdr) *)linkMap->l_addr;
+ if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0) return false;
+ const auto phdrs = (const ElfW(Phdr) *)(linkMap->l_addr + ehdr->e_phoff);
+
+ object = {linkMap->l_name, linkMap->l_addr, UINTPTR_MAX, 0, {}, ""};
+
+ uintptr_t relroStart = 0;
+ uintptr_t relroEnd = 0;
+ for (int i = 0; i < ehdr->e_phnum; i++)
+ {
+  const auto &phdr = phdrs[i];
+  if (phdr.p_type == PT_GNU_RELRO)
+  {
+   relroStart = linkMap->l_addr + phdr.p_vaddr;
+   relroEnd = relroStart + phdr.p_memsz;
+  }
+  if (phdr.p_type == PT_NOTE) readBuildId((const char *)(linkMap->l_addr + phdr.p_vaddr), phdr.p_memsz, object.buildId);
+  if (phdr.p_type != PT_LOAD) continue;
+  object.start = std::min(object.start, (uintptr_t)(linkMap->l_addr + phdr.p_vaddr));
+  object.end = std::max(object.end, (uintptr_t)(linkMap->l_addr + phdr.p_vaddr + phdr.p_memsz));
+  if (phdr.p_flags & PF_W) object.writableSegments.push_back({(char *)(linkMap->l_addr + phdr.p_vaddr), phdr.p_memsz});
+ }
+
+ // Leaving out the part that becomes read-only after relocation (GOT, dynamic section, etc)
+ for (auto &segment : object.writableSegments)
+ {
+  const uintptr_t segmentStart = (uintptr_t)segment.ptr;
+  const uintptr_t segmentEnd = segmentStart + segment.size;
+  if (relroStart <= segmentStart && relroEnd > segmentStart)
+  {
+   segment.ptr = (char *)std::min(relroEnd, segmentEnd);
+   segment.size = segmentEnd - (uintptr_t)segment.ptr;
+  }
+ }
+
+ return true;
+}
+
+// Gets the objects loaded in the same namespace as the given library handle
+static std::vector<loadedObject_t> getNamespaceObjects(void *dllHandle)
+{
+ struct link_map *linkMap;
+ if (dlinfo(dllHandle, RTLD_DI_LINKMAP, &linkMap) != 0) EXIT_WITH_ERROR("[Error] Could not get the link map of the sdlPopLib: %s\n", dlerror());
+ while (linkMap->l_prev != NULL) linkMap = linkMap->l_prev;
+
+ std::vector<loadedObject_t> objects;
+ for (; linkMap != NULL; linkMap = linkMap->l_next)
+ {
+  loadedObject_t object;
+  if (readLoadedObject(linkMap, object)) objects.push_back(object);
+ }
+
+ return objects;
+}
+
+// Gets the sdlPopLib itself among the objects of its namespace
+static const loadedObject_t &getLibraryObject(void *dllHandle, const std::vector<loadedObject_t> &objects)
+{
+ struct link_map *linkMap;
+ if (dlinfo(dllHandle, RTLD_DI_LINKMAP, &linkMap) != 0) EXIT_WITH_ERROR("[Error] Could not get the link map of the sdlPopLib: %s\n", dlerror());
+
+ for (const auto &object : objects)
+  if (object.base == linkMap->l_addr && object.name == linkMap->l_name) return object;
+
+ EXIT_WITH_ERROR("[Error] Could not find the program headers of %s\n", linkMap->l_name);
+}
+
+// Gets the address ranges of anonymous writable mappings (heap, mmap-based allocations)
+static std::vector<std::pair<uintptr_t, uintptr_t>> getHeapRanges()
+{
+  std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+  std::string maps;
+  if (loadStringFromFile(maps, "/proc/self/maps") == false) EXIT_WITH_ERROR("[Error] Could not read /proc/self/maps.\n");
+
+  // One mapping per line (split() would turn the line breaks into spaces)
+  std::istringstream stream(maps);
+  std::string line;
+  while (std::getline(stream, line))
+  {
+    uintptr_t start, end;
+    char permissions[8];
+    char path[POP_MAX_PATH] = "";
+    if (sscanf(line.c_str(), "%lx-%lx %7s %*s %*s %*s %255s", &start, &end, permissions, path) < 3) continue;
+    if (permissions[1] != 'w') continue;
+    if (path[0] == '\0' || strcmp(path, "[heap]") == 0) ranges.push_back({start, end});
+  }
+
+  // Every process has heap memory by now, so finding none means the mappings were not parsed
+  if (ranges.empty()) EXIT_WITH_ERROR("[Error] Could not find any heap mappings in /proc/self/maps.\n");
+
+  return ranges;
+}
+
+// Whether a value points into a heap range and not into a loaded object (whose bss may be anonymous memory too)
+static bool isHeapPointer(const uintptr_t value, const std::vector<std::pair<uintptr_t, uintptr_t>> &heapRanges, const std::vector<loadedObject_t> &objects)
+{
+ for (const auto &object : objects)
+  if (value >= object.start && value < object.end) return false;
+
+ for (const auto &range : heapRanges)
+  if (value >= range.first && value < range.second) return true;
+
+ return false;
+}
+
+std::vector<SDLPopInstance::segment_t> SDLPopInstance::getWritableSegments() const
+{
+ const auto objects = getNamespaceObjects(_dllHandle);
+ return getLibraryObject(_dllHandle, objects).writableSegments;
+}
+
+std::unique_ptr<SDLPopInstance> SDLPopInstance::clone() const
+{
+ // GUI resources (window, renderer, sounds) cannot be loaded again for the clone
+ if (*is_validate_mode == 0) EXIT_WITH_ERROR("[Error] Only SDLPop instances initialized without GUI can be cloned.\n");
+
+ std::unique_ptr<SDLPopInstance> clone(new SDLPopInstance(_libraryFile.c_str(), true));
+
+ const auto srcObjects = getNamespaceObjects(_dllHandle);
+ const auto dstObjects = getNamespaceObjects(clone->_dllHandle);
+ const auto &srcLibrary = getLibraryObject(_dllHandle, srcObjects);
+ const auto &dstLibrary = getLibraryObject(clone->_dllHandle, dstObjects);
+ const auto heapRanges = getHeapRanges();
+
+ // Pointer relocation: values within an object of the source namespace are moved to the same object in the
+ // clone's namespace. Objects shared by both namespaces (e.g., the executable) keep their address. The writable
+ // data of the other libraries (e.g., SDL2's) is only initialized in the source namespace, so pointers to it
+ // are cleared instead
+ struct relocation_t
+ {
+  const loadedObject_t *object;
+  ptrdiff_t delta;
+  bool isLibrary;
+ };
+ std::vector<relocation_t> relocations;
+ for (const auto &srcObject : srcObjects)
+  for (const auto &dstObject : dstObjects)
+   if (srcObject.name == dstObject.name) relocations.push_back({&srcObject, (ptrdiff_t)(dstObject.base - srcObject.base), &srcObject == &srcLibrary});
+
+ if (srcLibrary.writableSegments.size() != dstLibrary.writableSegments.size()) EXIT_WITH_ERROR("[Error] Source and clone sdlPopLib segments do not match.\n");
+
+ for (size_t i = 0; i < srcLibrary.writableSegments.size(); i++)
+ {
+  const auto &srcSegment = srcLibrary.writableSegments[i];
+  const auto &dstSegment = dstLibrary.writableSegments[i];
+  memcpy(dstSegment.ptr, srcSegment.ptr, srcSegment.size);
+
+  // Pointers are naturally aligned, so only aligned words need to be checked
+  const uintptr_t firstWord = ((uintptr_t)dstSegment.ptr + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+  const uintptr_t lastWord = (uintptr_t)dstSegment.ptr + dstSegment.size - sizeof(uintptr_t);
+  for (uintptr_t pos = firstWord; pos <= lastWord; pos += sizeof(uintptr_t))
+  {
+   uintptr_t &value = *(uintptr_t *)pos;
+   bool isObjectPointer = false;
+
+   for (const auto &relocation : relocations)
+    if (value >= relocation.object->start && value < relocation.object->end)
+    {
+     bool isDependencyData = false;
+     if (relocation.isLibrary == false)
+      for (const auto &segment : relocation.object->writableSegments)
+       if (value >= (uintptr_t)segment.ptr && value < (uintptr_t)segment.ptr + segment.size) isDependencyData = true;
+
+     value = isDependencyData ? 0 : value + relocation.delta;
+     isObjectPointer = true;
+     break;
+    }
+
+   // Heap memory belongs to the source's allocator, so it can be neither used nor freed by the clone
+   if (isObjectPointer == false)
+    for (const auto &range : heapRanges)
+     if (value >= range.first && value < range.second)
+     {
+      value = 0;
+      break;
+     }
+  }
+ }
+
+ // Copying the instance-side state
+ clone->_isSimulationOnly = _isSimulationOnly;
+ clone->_useLevelCache = _useLevelCache;
+ clone->_IGTMins = _IGTMins;
+ clone->_IGTSecs = _IGTSecs;
+ clone->_IGTMillisecs = _IGTMillisecs;
+ clone->_move = _move;
+ clone->_sdlPopRoot = _sdlPopRoot;
+ clone->_prevDrawnRoom = _prevDrawnRoom;
+ clone->_pristineLevels = _pristineLevels;
+ memcpy(clone->quick_control, quick_control, sizeof(quick_control));
+ clone->replay_curr_tick = replay_curr_tick;
+
+ // Giving the clone its own copy of the file cache and of the heap-backed resources, as a warm start does
+ *clone->_cachedFileCounter = 0;
+ clone->deserializeFileCache(const_cast<SDLPopInstance *>(this)->serializeFileCache());
+ clone->reloadHeapResources();
+ clone->updateLevelFeatures();
+
+ return clone;
+}
+
+std::vector<uintptr_t *> SDLPopInstance::getHeapPointers() const
+{
+ const auto objects = getNamespaceObjects(_dllHandle);
+ const auto heapRanges = getHeapRanges();
+
+ std::vector<uintptr_t *> heapPointers;
+ for (const auto &segment : getLibraryObject(_dllHandle, objects).writableSegments)
+ {
+  const uintptr_t firstWord = ((uintptr_t)segment.ptr + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+  const uintptr_t lastWord = (uintptr_t)segment.ptr + segment.size - sizeof(uintptr_t);
+  for (uintptr_t pos = firstWord; pos <= lastWord; pos += sizeof(uintptr_t))
+   if (isHeapPointer(*(const uintptr_t *)pos, heapRanges, objects)) heapPointers.push_back((uintptr_t *)pos);
+ }
+
+ return heapPointers;
+}
+
+size_t SDLPopInstance::countSharedHeapPointers(const SDLPopInstance &other) const
+{
+ const auto objects = getNamespaceObjects(_dllHandle);
+ const auto segments = getLibraryObject(_dllHandle, objects).writableSegments;
+ const auto otherSegments = other.getWritableSegments();
+ const auto heapRanges = getHeapRanges();
+ if (segments.size() != otherSegments.size()) EXIT_WITH_ERROR("[Error] The sdlPopLib segments of both instances do not match.\n");
+
+ size_t sharedPointers = 0;
+ for (size_t i = 0; i < segments.size(); i++)
+ {
+  const uintptr_t firstWord = ((uintptr_t)segments[i].ptr + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+  const uintptr_t lastWord = (uintptr_t)segments[i].ptr + segments[i].size - sizeof(uintptr_t);
+  for (uintptr_t pos = firstWord; pos <= lastWord; pos += sizeof(uintptr_t))
+  {
+   const uintptr_t value = *(const uintptr_t *)pos;
+   const uintptr_t otherValue = *(const uintptr_t *)(otherSegments[i].ptr + (pos - (uintptr_t)segments[i].ptr));
+   if (value == otherValue && isHeapPointer(value, heapRanges, objects)) sharedPointers++;
+  }
+ }
+
+ return sharedPointers;
+}
+
+void SDLPopInstance::storeContext(context_t &context) const
+{
+  size_t pos = 0;
+  for (const auto &segment : _contextSegments)
+  {
+    memcpy(&context.segmentData[pos], segment.ptr, segment.size);
+    pos += segment.size;
+  }
+
+  context.prevDrawnRoom = _prevDrawnRoom;
+  memcpy(context.quickControl, quick_control, sizeof(quick_control));
+  context.replayCurrTick = replay_curr_tick;
+  context.move = _move;
+}
+
+void SDLPopInstance::restoreContext(const context_t &context)
+{
+  size_t pos = 0;
+  for (const auto &segment : _contextSegments)
+  {
+    memcpy(segment.ptr, &context.segmentData[pos], segment.size);
+    pos += segment.size;
+  }
+
+  _prevDrawnRoom = context.prevDrawnRoom;
+  memcpy(quick_control, context.quickControl, sizeof(quick_control));
+  replay_curr_tick = context.replayCurrTick;
+  _move = context.move;
+  updateLevelFeatures();
+}
+
+size_t SDLPopInstance::createContext()
+{
+  // Contexts share the sprites, so these must never be freed by a level change in any of them
+  if (_isSimulationOnly == false || _useLevelCache == false) EXIT_WITH_ERROR("[Error] Emulator contexts require a simulation-only SDLPop instance with the level cache enabled.\n");
+
+  std::lock_guard<std::mutex> lock(_contextMutex);
+
+  // The live memory becomes context 0 upon creating the first additional context
+  if (_contexts.empty())
+  {
+    _contextSegments = getWritableSegments();
+    size_t segmentSize = 0;
+    for (const auto &segment : _contextSegments) segmentSize += segment.size;
+
+    _contexts.resize(1);
+    _contexts[0].segmentData.resize(segmentSize);
+    _activeContext = 0;
+  }
+
+  _contexts.push_back(_contexts[_activeContext]);
+  storeContext(_contexts.back());
+  return _contexts.size() - 1;
+}
+
+void SDLPopInstance::switchContext(const size_t contextId)
+{
+  if (contextId >= std::max(_contexts.size(), (size_t)1)) EXIT_WITH_ERROR("[Error] Requested context %lu, but only %lu exist.\n", contextId, _contexts.size());
+  if (contextId == _activeContext) return;
+
+  storeContext(_contexts[_activeContext]);
+  restoreContext(_contexts[contextId]);
+  _activeContext = contextId;
+}
+
+std::unique_lock<std::mutex> SDLPopInstance::acquireContext(const size_t contextId)
+{
+  std::unique_lock<std::mutex> lock(_contextMutex);
+  switchContext(contextId);
+  return lock;
+}
+
+// Warm-start image layout: [header][object names][segments][relocations][heap references][file cache][level cache]
+#define _WARM_START_MAGIC "JAFFARWS"
+#define _WARM_START_VERSION 2
+
+struct warmStartHeader_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t segmentCount;
+  uint64_t key;
+  uint64_t objectCount;
+  uint64_t relocationCount;
+  uint64_t heapReferenceCount;
+  uint64_t fileCacheSize;
+  uint64_t levelCount;
+};
+
+// Pristine level struct, as stored in the level cache
+struct warmStartLevel_t
+{
+  uint64_t levelId;
+  level_type level;
+};
+
+// Pointer stored in a segment: its position and the object (and offset within it) it points to
+struct warmStartRelocation_t
+{
+  uint32_t segment;
+  uint32_t object;
+  uint64_t position;
+  uint64_t offset;
+};
+
+// Pointer to heap memory stored in a segment, which is cleared upon restoring
+struct warmStartHeapReference_t
+{
+  uint32_t segment;
+  uint64_t position;
+};
+
+// Hashes a game file, looking for it first as given and then in the SDLPoP folder and its data subfolder
+static uint64_t hashGameFile(const std::string &sdlPopRoot, const char *fileName)
+{
+  std::string contents;
+  if (loadStringFromFile(contents, fileName) == false)
+    if (loadStringFromFile(contents, (sdlPopRoot + "/" + fileName).c_str()) == false)
+      loadStringFromFile(contents, (sdlPopRoot + "/data/" + fileName).c_str());
+  return hashBuffer(contents.data(), contents.size());
+}
+
+uint64_t SDLPopInstance::getWarmStartKey() const
+{
+  const auto objects = getNamespaceObjects(_dllHandle);
+  const auto &library = getLibraryObject(_dllHandle, objects);
+
+  Hasher hasher;
+  hasher.update((uint32_t)_WARM_START_VERSION);
+
+  // Libraries built without a build ID are identified by their contents
+  if (library.buildId.empty() == false)
+    hasher.update(library.buildId.data(), library.buildId.size());
+  else
+    hasher.update(hashGameFile("", library.name.c_str()));
+
+  hasher.update(hashGameFile(*exe_dir, *levels_file));
+  hasher.update(hashGameFile(*exe_dir, "PRINCE.DAT"));
+  return hasher.digest();
+}
+
+void SDLPopInstance::saveWarmStartImage(const char *fileName) const
+{
+  const auto objects = getNamespaceObjects(_dllHandle);
+  const auto &library = getLibraryObject(_dllHandle, objects);
+  const auto heapRanges = getHeapRanges();
+
+  std::string objectNames;
+  for (const auto &object : objects) objectNames.append(object.name.c_str(), object.name.size() + 1);
+
+  // Classifying every aligned word of the writable segments that points to an object or to the heap
+  std::string segments;
+  std::vector<warmStartRelocation_t> relocations;
+  std::vector<warmStartHeapReference_t> heapReferences;
+  for (size_t i = 0; i < library.writableSegments.size(); i++)
+  {
+    const auto &segment = library.writableSegments[i];
+    const uint64_t segmentOffset = (uintptr_t)segment.ptr - library.base;
+    const uint64_t segmentSize = segment.size;
+    segments.append((const char *)&segmentOffset, sizeof(segmentOffset));
+    segments.append((const char *)&segmentSize, sizeof(segmentSize));
+    segments.append(segment.ptr, segment.size);
+
+    const uintptr_t firstWord = ((uintptr_t)segment.ptr + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+    const uintptr_t lastWord = (uintptr_t)segment.ptr + segment.size - sizeof(uintptr_t);
+    for (uintptr_t pos = firstWord; pos <= lastWord; pos += sizeof(uintptr_t))
+    {
+      const uintptr_t value = *(const uintptr_t *)pos;
+      const uint64_t position = pos - (uintptr_t)segment.ptr;
+      bool isRelocation = false;
+
+      for (size_t j = 0; j < objects.size() && isRelocation == false; j++)
+        if (value >= objects[j].start && value < objects[j].end)
+        {
+          relocations.push_back({(uint32_t)i, (uint32_t)j, position, value - objects[j].base});
+          isRelocation = true;
+        }
+
+      if (isRelocation == false)
+        for (const auto &range : heapRanges)
+          if (value >= range.first && value < range.second)
+          {
+            heapReferences.push_back({(uint32_t)i, position});
+            break;
+          }
+    }
+  }
+
+  const std::string fileCache = const_cast<SDLPopInstance *>(this)->serializeFileCache();
+
+  // Storing the level cache, so that resuming does not parse the levels file again
+  std::vector<warmStartLevel_t> levels;
+  for (const auto &entry : _pristineLevels) levels.push_back({entry.first, entry.second});
+
+  warmStartHeader_t header;
+  memcpy(header.magic, _WARM_START_MAGIC, sizeof(header.magic));
+  header.version = _WARM_START_VERSION;
+  header.segmentCount = library.writableSegments.size();
+  header.key = getWarmStartKey();
+  header.objectCount = objects.size();
+  header.relocationCount = relocations.size();
+  header.heapReferenceCount = heapReferences.size();
+  header.fileCacheSize = fileCache.size();
+  header.levelCount = levels.size();
+
+  std::string image;
+  image.append((const char *)&header, sizeof(header));
+  image.append(objectNames);
+  image.append(segments);
+  image.append((const char *)relocations.data(), relocations.size() * sizeof(warmStartRelocation_t));
+  image.append((const char *)heapReferences.data(), heapReferences.size() * sizeof(warmStartHeapReference_t));
+  image.append(fileCache);
+  image.append((const char *)levels.data(), levels.size() * sizeof(warmStartLevel_t));
+
+  // Writing to a temporary file first, so that concurrent processes never map a partially written image
+  const std::string tmpFileName = std::string(fileName) + ".tmp." + std::to_string(getpid());
+  if (saveStringToFile(image, tmpFileName.c_str()) == false) EXIT_WITH_ERROR("[Error] Could not write warm-start image: %s\n", tmpFileName.c_str());
+  if (rename(tmpFileName.c_str(), fileName) != 0) EXIT_WITH_ERROR("[Error] Could not write warm-start image: %s\n", fileName);
+}
+
+bool SDLPopInstance::loadWarmStartImage(const char *fileName)
+{
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  // The image is read in place from the mapping. Only the segment contents, which must live at the library's
+  // own addresses, and the file cache buffers, which the sdlPopLib owns (and may free), are copied out of it
+  const size_t imageSize = fileStat.st_size;
+  void *mapping = imageSize >= sizeof(warmStartHeader_t) ? mmap(NULL, imageSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+
+  // Unmapping the image on every exit, including errors
+  struct mappingGuard_t
+  {
+    void *ptr;
+    size_t size;
+    ~mappingGuard_t() { munmap(ptr, size); }
+  } mappingGuard = {mapping, imageSize};
+
+  const char *image = (const char *)mapping;
+  const auto &header = *(const warmStartHeader_t *)image;
+
+  // Images from other library builds, game files or layouts are ignored
+  const auto objects = getNamespaceObjects(_dllHandle);
+  const auto &library = getLibraryObject(_dllHandle, objects);
+  if (memcmp(header.magic, _WARM_START_MAGIC, sizeof(header.magic)) != 0 || header.version != _WARM_START_VERSION || header.key != getWarmStartKey() ||
+      header.segmentCount != library.writableSegments.size())
+    return false;
+
+  // Whether count elements of the given size fit in the rest of the image (written so that it cannot overflow)
+  size_t pos = sizeof(warmStartHeader_t);
+  const auto fits = [&](const uint64_t count, const size_t elementSize) { return pos <= imageSize && count <= (imageSize - pos) / elementSize; };
+
+  // Mapping the objects named in the image to the ones in this namespace
+  std::vector<const loadedObject_t *> imageObjects;
+  for (size_t i = 0; i < header.objectCount; i++)
+  {
+    const char *nameEnd = fits(1, 1) ? (const char *)memchr(&image[pos], '\0', imageSize - pos) : NULL;
+    if (nameEnd == NULL) EXIT_WITH_ERROR("[Error] Warm-start image %s is truncated.\n", fileName);
+    const std::string name(&image[pos], nameEnd - &image[pos]);
+    pos += name.size() + 1;
+    imageObjects.push_back(NULL);
+
+    // The executable (unnamed) may not be the same one that wrote the image
+    for (const auto &object : objects)
+      if (name.empty() == false && object.name == name) imageObjects.back() = &object;
+  }
+
+  // Restoring segment contents
+  for (const auto &segment : library.writableSegments)
+  {
+    if (fits(2, sizeof(uint64_t)) == false) EXIT_WITH_ERROR("[Error] Warm-start image %s is truncated.\n", fileName);
+    const uint64_t segmentOffset = *(const uint64_t *)&image[pos];
+    const uint64_t segmentSize = *(const uint64_t *)&image[pos + sizeof(uint64_t)];
+    pos += 2 * sizeof(uint64_t);
+    if (segmentOffset != (uintptr_t)segment.ptr - library.base || segmentSize != segment.size) EXIT_WITH_ERROR("[Error] Warm-start image segments do not match the sdlPopLib.\n");
+    if (fits(segmentSize, 1) == false) EXIT_WITH_ERROR("[Error] Warm-start image %s is truncated.\n", fileName);
+    memcpy(segment.ptr, &image[pos], segmentSize);
+    pos += segmentSize;
+  }
+
+  // Whether a pointer-sized word at the given position lies within a segment
+  const auto isValidPosition = [&](const uint32_t segment, const uint64_t position) {
+    if (segment >= library.writableSegments.size()) return false;
+    const size_t segmentSize = library.writableSegments[segment].size;
+    return segmentSize >= sizeof(uintptr_t) && position <= segmentSize - sizeof(uintptr_t);
+  };
+
+  // Relocating pointers. Those to objects not present in this namespace (e.g., another executable) are cleared
+  if (fits(header.relocationCount, sizeof(warmStartRelocation_t)) == false) EXIT_WITH_ERROR("[Error] Warm-start image %s is truncated.\n", fileName);
+  const auto relocations = (const warmStartRelocation_t *)&image[pos];
+  pos += header.relocationCount * sizeof(warmStartRelocation_t);
+  for (size_t i = 0; i < header.relocationCount; i++)
+  {
+    const auto &relocation = relocations[i];
+    if (isValidPosition(relocation.segment, relocation.position) == false || relocation.object >= imageObjects.size())
+      EXIT_WITH_ERROR("[Error] Warm-start image %s has an invalid relocation.\n", fileName);
+    auto &value = *(uintptr_t *)(library.writableSegments[relocation.segment].ptr + relocation.position);
+    const auto object = imageObjects[relocation.object];
+    value = object == NULL ? 0 : object->base + relocation.offset;
+  }
+
+  // Heap memory is not part of the image, so pointers to it are cleared and the resources are loaded again below
+  if (fits(header.heapReferenceCount, sizeof(warmStartHeapReference_t)) == false) EXIT_WITH_ERROR("[Error] Warm-start image %s is truncated.\n", fileName);
+  const auto heapReferences = (const warmStartHeapReference_t *)&image[pos];
+  pos += header.heapReferenceCount * sizeof(warmStartHeapReference_t);
+  for (size_t i = 0; i < header.heapReferenceCount; i++)
+  {
+    if (isValidPosition(heapReferences[i].segment, heapReferences[i].position) == false)
+      EXIT_WITH_ERROR("[Error] Warm-start image %s has an invalid heap reference.\n", fileName);
+    *(uintptr_t *)(library.writableSegments[heapReferences[i].segment].ptr + heapReferences[i].position) = 0;
+  }
+
+  if (fits(header.fileCacheSize, 1) == false) EXIT_WITH_ERROR("[Error] Warm-start image %s is truncated.\n", fileName);
+  *_cachedFileCounter = 0;
+  deserializeFileCache(std::string_view(&image[pos], header.fileCacheSize));
+  pos += header.fileCacheSize;
+
+  // Taking the level cache from the image instead of parsing every level again
+  if (fits(header.levelCount, sizeof(warmStartLevel_t)) == false) EXIT_WITH_ERROR("[Error] Warm-start image %s is truncated.\n", fileName);
+  const auto levels = (const warmStartLevel_t *)&image[pos];
+  _pristineLevels.clear();
+  for (size_t i = 0; i < header.levelCount; i++) _pristineLevels[levels[i].levelId] = levels[i].level;
+
+  reloadHeapResources();
+
+  updateLevelFeatures();
+  return true;
+}
+
+void SDLPopInstance::reloadHeapResources()
+{
+  // Reloading heap-backed resources: video buffers, palettes and sprites. Sounds are not restored
+  *g_argv = __prince_argv;
+  parse_grmode();
+  init_timer(BASE_FPS);
+  set_hc_pal();
+  *current_target_surface = rect_sthg(*onscreen_surface_, screen_rect);
+  *dathandle = open_dat("PRINCE.DAT", 0);
+  *guard_palettes = (byte *)load_from_opendats_alloc(10, "bin", NULL, NULL);
+  *level_var_palettes = reinterpret_cast<byte *>(load_from_opendats_alloc(20, "bin", NULL, NULL));
+  (*chtab_addrs)[id_chtab_0_sword] = load_sprites_from_file(700, 1 << 2, 1);
+  (*chtab_addrs)[id_chtab_1_flameswordpotion] = load_sprites_from_file(150, 1 << 3, 1);
+  close_dat(*dathandle);
+  *offscreen_surface = make_offscreen_buffer(rect_top);
+  load_kid_sprite();
+  loadLevelSprites(*current_level);
+  load_room_links();
 }
 
 SDLPopInstance::SDLPopInstance(const char* libraryFile, const bool multipleLibraries)
@@ -566,209 +1588,12 @@ SDLPopInstance::SDLPopInstance(const char* libraryFile, const bool multipleLibra
   else
    _dllHandle = dlopen (libraryFile, RTLD_NOW);
 
+  _libraryFile = libraryFile;
+
   if (!_dllHandle)
-    EXIT_WITH_ERROR("Could not load %s. Check that this library's path is included in the LD_LIBRARY_PATH environment variable. Try also reducing the number of openMP threads.\n", libraryFile);
-
-  // Functions
-  restore_room_after_quick_load = (restore_room_after_quick_load_t)dlsym(_dllHandle, "restore_room_after_quick_load");
-  load_global_options = (load_global_options_t)dlsym(_dllHandle, "load_global_options");
-  check_mod_param = (check_mod_param_t)dlsym(_dllHandle, "check_mod_param");
-  load_ingame_settings = (load_ingame_settings_t)dlsym(_dllHandle, "load_ingame_settings");
-  turn_sound_on_off = (turn_sound_on_off_t)dlsym(_dllHandle, "turn_sound_on_off");
-  load_mod_options = (load_mod_options_t)dlsym(_dllHandle, "load_mod_options");
-  apply_seqtbl_patches = (apply_seqtbl_patches_t)dlsym(_dllHandle, "apply_seqtbl_patches");
-  open_dat = (open_dat_t)dlsym(_dllHandle, "open_dat");
-  parse_grmode = (parse_grmode_t)dlsym(_dllHandle, "parse_grmode");
-  init_timer = (init_timer_t)dlsym(_dllHandle, "init_timer");
-  parse_cmdline_sound = (parse_cmdline_sound_t)dlsym(_dllHandle, "parse_cmdline_sound");
-  set_hc_pal = (set_hc_pal_t)dlsym(_dllHandle, "set_hc_pal");
-  rect_sthg = (rect_sthg_t)dlsym(_dllHandle, "rect_sthg");
-  show_loading = (show_loading_t)dlsym(_dllHandle, "show_loading");
-  set_joy_mode = (set_joy_mode_t)dlsym(_dllHandle, "set_joy_mode");
-  init_copyprot_dialog = (init_copyprot_dialog_t)dlsym(_dllHandle, "init_copyprot_dialog");
-  init_record_replay = (init_record_replay_t)dlsym(_dllHandle, "init_record_replay");
-  init_menu = (init_menu_t)dlsym(_dllHandle, "init_menu");
-  prandom = (prandom_t)dlsym(_dllHandle, "prandom");
-  load_from_opendats_alloc = (load_from_opendats_alloc_t)dlsym(_dllHandle, "load_from_opendats_alloc");
-  set_pal_256 = (set_pal_256_t)dlsym(_dllHandle, "set_pal_256");
-  set_pal = (set_pal_t)dlsym(_dllHandle, "set_pal");
-  load_sprites_from_file = (load_sprites_from_file_t)dlsym(_dllHandle, "load_sprites_from_file");
-  close_dat = (close_dat_t)dlsym(_dllHandle, "close_dat");
-  init_lighting = (init_lighting_t)dlsym(_dllHandle, "init_lighting");
-  load_all_sounds = (load_all_sounds_t)dlsym(_dllHandle, "load_all_sounds");
-  release_title_images = (release_title_images_t)dlsym(_dllHandle, "release_title_images");
-  free_optsnd_chtab = (free_optsnd_chtab_t)dlsym(_dllHandle, "free_optsnd_chtab");
-  make_offscreen_buffer = (make_offscreen_buffer_t)dlsym(_dllHandle, "make_offscreen_buffer");
-  load_lev_spr = (load_lev_spr_t)dlsym(_dllHandle, "load_lev_spr");
-  load_level = (load_level_t)dlsym(_dllHandle, "load_level");
-  pos_guards = (pos_guards_t)dlsym(_dllHandle, "pos_guards");
-  clear_coll_rooms = (clear_coll_rooms_t)dlsym(_dllHandle, "clear_coll_rooms");
-  clear_saved_ctrl = (clear_saved_ctrl_t)dlsym(_dllHandle, "clear_saved_ctrl");
-  do_startpos = (do_startpos_t)dlsym(_dllHandle, "do_startpos");
-  find_start_level_door = (find_start_level_door_t)dlsym(_dllHandle, "find_start_level_door");
-  check_sound_playing = (check_sound_playing_t)dlsym(_dllHandle, "check_sound_playing");
-  do_paused = (check_sound_playing_t)dlsym(_dllHandle, "do_paused");
-  load_kid_sprite = (load_kid_sprite_t)dlsym(_dllHandle, "load_kid_sprite");
-  idle = (idle_t)dlsym(_dllHandle, "idle");
-  hof_read = (hof_read_t)dlsym(_dllHandle, "hof_read");
-  stop_sounds = (stop_sounds_t)dlsym(_dllHandle, "stop_sounds");
-  show_copyprot = (show_copyprot_t)dlsym(_dllHandle, "show_copyprot");
-  reset_timer = (reset_timer_t)dlsym(_dllHandle, "reset_timer");
-  free_peels = (free_peels_t)dlsym(_dllHandle, "free_peels");
-  play_level_2 = (play_level_2_t)dlsym(_dllHandle, "play_level_2");
-  timers = (timers_t)dlsym(_dllHandle, "timers");
-  play_frame = (play_frame_t)dlsym(_dllHandle, "play_frame");
-  draw_game_frame = (draw_game_frame_t)dlsym(_dllHandle, "draw_game_frame");
-  update_screen = (update_screen_t)dlsym(_dllHandle, "update_screen");
-  do_simple_wait = (do_simple_wait_t)dlsym(_dllHandle, "do_simple_wait");
-  reset_level_unused_fields = (reset_level_unused_fields_t)dlsym(_dllHandle, "reset_level_unused_fields");
-  load_room_links = (load_room_links_t)dlsym(_dllHandle, "load_room_links");
-  set_timer_length = (set_timer_length_t)dlsym(_dllHandle, "set_timer_length");
-  draw_level_first = (draw_level_first_t)dlsym(_dllHandle, "draw_level_first");
-  play_level = (play_level_t)dlsym(_dllHandle, "play_level");
-  save_recorded_replay = (save_recorded_replay_t)dlsym(_dllHandle, "save_recorded_replay");
-  start_recording = (start_recording_t)dlsym(_dllHandle, "start_recording");
-  add_replay_move = (add_replay_move_t)dlsym(_dllHandle, "add_replay_move");
-  process_trobs = (process_trobs_t)dlsym(_dllHandle, "process_trobs");
-  do_mobs = (do_mobs_t)dlsym(_dllHandle, "do_mobs");
-  check_skel = (check_skel_t)dlsym(_dllHandle, "check_skel");
-  check_can_guard_see_kid = (check_can_guard_see_kid_t)dlsym(_dllHandle, "check_can_guard_see_kid");
-  open_dat = (open_dat_t)dlsym(_dllHandle, "open_dat");
-  check_mirror = (check_mirror_t)dlsym(_dllHandle, "check_mirror");
-  init_copyprot = (init_copyprot_t)dlsym(_dllHandle, "init_copyprot");
-  alter_mods_allrm = (alter_mods_allrm_t) dlsym(_dllHandle, "alter_mods_allrm");
-  start_replay = (start_replay_t) dlsym(_dllHandle, "start_replay");
-  start_game = (start_game_t) dlsym(_dllHandle, "start_game");
-  display_text_bottom = (display_text_bottom_t) dlsym(_dllHandle, "display_text_bottom");
-  redraw_screen = (redraw_screen_t) dlsym(_dllHandle, "redraw_screen");
-  draw_image_transp_vga = (draw_image_transp_vga_t) dlsym(_dllHandle, "draw_image_transp_vga");
-
-  // State variables
-  Kid = (char_type *)dlsym(_dllHandle, "Kid");
-  Guard = (char_type *)dlsym(_dllHandle, "Guard");
-  Char = (char_type *)dlsym(_dllHandle, "Char");
-  Opp = (char_type *)dlsym(_dllHandle, "Opp");
-  trobs_count = (short *)dlsym(_dllHandle, "trobs_count");
-  trobs = (trobs_t *)dlsym(_dllHandle, "trobs");
-  mobs_count = (short *)dlsym(_dllHandle, "mobs_count");
-  mobs = (mobs_t *)dlsym(_dllHandle, "mobs");
-  level = (level_type *)dlsym(_dllHandle, "level");
-  drawn_room = (word *)dlsym(_dllHandle, "drawn_room");
-  leveldoor_open = (word *)dlsym(_dllHandle, "leveldoor_open");
-  hitp_curr = (word *)dlsym(_dllHandle, "hitp_curr");
-  guardhp_curr = (word *)dlsym(_dllHandle, "guardhp_curr");
-  current_level = (word *)dlsym(_dllHandle, "current_level");
-  next_level = (word *)dlsym(_dllHandle, "next_level");
-  checkpoint = (word *)dlsym(_dllHandle, "checkpoint");
-  upside_down = (word *)dlsym(_dllHandle, "upside_down");
-  exit_room_timer = (word *)dlsym(_dllHandle, "exit_room_timer");
-  hitp_max = (word *)dlsym(_dllHandle, "hitp_max");
-  hitp_beg_lev = (word *)dlsym(_dllHandle, "hitp_beg_lev");
-  grab_timer = (word *)dlsym(_dllHandle, "grab_timer");
-  holding_sword = (word *)dlsym(_dllHandle, "holding_sword");
-  united_with_shadow = (short *)dlsym(_dllHandle, "united_with_shadow");
-  pickup_obj_type = (short *)dlsym(_dllHandle, "pickup_obj_type");
-  kid_sword_strike = (word *)dlsym(_dllHandle, "kid_sword_strike");
-  offguard = (word *)dlsym(_dllHandle, "offguard");
-  have_sword = (word *)dlsym(_dllHandle, "have_sword");
-  guardhp_max = (word *)dlsym(_dllHandle, "guardhp_max");
-  demo_index = (word *)dlsym(_dllHandle, "demo_index");
-  demo_time = (short *)dlsym(_dllHandle, "demo_time");
-  curr_guard_color = (word *)dlsym(_dllHandle, "curr_guard_color");
-  guard_notice_timer = (short *)dlsym(_dllHandle, "guard_notice_timer");
-  guard_skill = (word *)dlsym(_dllHandle, "guard_skill");
-  shadow_initialized = (word *)dlsym(_dllHandle, "shadow_initialized");
-  guard_refrac = (word *)dlsym(_dllHandle, "guard_refrac");
-  justblocked = (word *)dlsym(_dllHandle, "justblocked");
-  droppedout = (word *)dlsym(_dllHandle, "droppedout");
-  curr_row_coll_room = (curr_row_coll_room_t *)dlsym(_dllHandle, "curr_row_coll_room");
-  curr_row_coll_flags = (curr_row_coll_flags_t *)dlsym(_dllHandle, "curr_row_coll_flags");
-  above_row_coll_room = (above_row_coll_room_t *)dlsym(_dllHandle, "above_row_coll_room");
-  above_row_coll_flags = (above_row_coll_flags_t *)dlsym(_dllHandle, "above_row_coll_flags");
-  below_row_coll_room = (below_row_coll_room_t *)dlsym(_dllHandle, "below_row_coll_room");
-  below_row_coll_flags = (below_row_coll_flags_t *)dlsym(_dllHandle, "below_row_coll_flags");
-  prev_collision_row = (sbyte *)dlsym(_dllHandle, "prev_collision_row");
-  flash_color = (word *)dlsym(_dllHandle, "flash_color");
-  flash_time = (word *)dlsym(_dllHandle, "flash_time");
-  need_level1_music = (word *)dlsym(_dllHandle, "need_level1_music");
-  is_screaming = (word *)dlsym(_dllHandle, "is_screaming");
-  is_feather_fall = (word *)dlsym(_dllHandle, "is_feather_fall");
-  last_loose_sound = (word *)dlsym(_dllHandle, "last_loose_sound");
-  random_seed = (dword *)dlsym(_dllHandle, "random_seed");
-  preserved_seed = (dword *)dlsym(_dllHandle, "preserved_seed");
-  rem_min = (short *)dlsym(_dllHandle, "rem_min");
-  rem_tick = (word *)dlsym(_dllHandle, "rem_tick");
-  control_x = (sbyte *)dlsym(_dllHandle, "control_x");
-  control_y = (sbyte *)dlsym(_dllHandle, "control_y");
-  control_shift = (sbyte *)dlsym(_dllHandle, "control_shift");
-  control_forward = (sbyte *)dlsym(_dllHandle, "control_forward");
-  control_backward = (sbyte *)dlsym(_dllHandle, "control_backward");
-  control_up = (sbyte *)dlsym(_dllHandle, "control_up");
-  control_down = (sbyte *)dlsym(_dllHandle, "control_down");
-  control_shift2 = (sbyte *)dlsym(_dllHandle, "control_shift2");
-  ctrl1_forward = (sbyte *)dlsym(_dllHandle, "ctrl1_forward");
-  ctrl1_backward = (sbyte *)dlsym(_dllHandle, "ctrl1_backward");
-  ctrl1_up = (sbyte *)dlsym(_dllHandle, "ctrl1_up");
-  ctrl1_down = (sbyte *)dlsym(_dllHandle, "ctrl1_down");
-  ctrl1_shift2 = (sbyte *)dlsym(_dllHandle, "ctrl1_shift2");
-  curr_tick = (dword *)dlsym(_dllHandle, "curr_tick");
-  dathandle = (dat_type **)dlsym(_dllHandle, "dathandle");
-  level_var_palettes = (byte **)dlsym(_dllHandle, "level_var_palettes");
-  is_blind_mode = (word *)dlsym(_dllHandle, "is_blind_mode");
-  seed_was_init = (word *)dlsym(_dllHandle, "seed_was_init");
-  dathandle = (dat_type **)dlsym(_dllHandle, "dathandle");
-  need_drects = (word *)dlsym(_dllHandle, "need_drects");
-  g_argc = (int *)dlsym(_dllHandle, "g_argc");
-  g_argv = (char ***)dlsym(_dllHandle, "g_argv");
-  current_target_surface = (surface_type **)dlsym(_dllHandle, "current_target_surface");
-  onscreen_surface_ = (SDL_Surface **)dlsym(_dllHandle, "onscreen_surface_");
-  screen_rect = (rect_type *)dlsym(_dllHandle, "screen_rect");
-  cheats_enabled = (word *)dlsym(_dllHandle, "cheats_enabled");
-  draw_mode = (word *)dlsym(_dllHandle, "draw_mode");
-  demo_mode = (word *)dlsym(_dllHandle, "demo_mode");
-  play_demo_level = (int *)dlsym(_dllHandle, "play_demo_level");
-  doorlink1_ad = (byte **)dlsym(_dllHandle, "doorlink1_ad");
-  doorlink2_ad = (byte **)dlsym(_dllHandle, "doorlink2_ad");
-  guard_palettes = (byte **)dlsym(_dllHandle, "guard_palettes");
-  chtab_addrs = (chtab_addrs_t *)dlsym(_dllHandle, "chtab_addrs");
-  start_level = (short *)dlsym(_dllHandle, "start_level");
-  offscreen_surface = (surface_type **)dlsym(_dllHandle, "offscreen_surface");
-  rect_top = (rect_type *)dlsym(_dllHandle, "rect_top");
-  text_time_remaining = (word *)dlsym(_dllHandle, "text_time_remaining");
-  text_time_total = (word *)dlsym(_dllHandle, "text_time_total");
-  is_show_time = (word *)dlsym(_dllHandle, "is_show_time");
-  resurrect_time = (word *)dlsym(_dllHandle, "resurrect_time");
-  custom = (custom_options_type **)dlsym(_dllHandle, "custom");
-  next_sound = (short *)dlsym(_dllHandle, "next_sound");
-  can_guard_see_kid = (short *)dlsym(_dllHandle, "can_guard_see_kid");
-  hitp_delta = (short *)dlsym(_dllHandle, "hitp_delta");
-  guardhp_delta = (short *)dlsym(_dllHandle, "guardhp_delta");
-  different_room = (word *)dlsym(_dllHandle, "different_room");
-  next_room = (word *)dlsym(_dllHandle, "next_room");
-  is_guard_notice = (word *)dlsym(_dllHandle, "is_guard_notice");
-  need_full_redraw = (word *)dlsym(_dllHandle, "need_full_redraw");
-  is_validate_mode = (byte *)dlsym(_dllHandle, "is_validate_mode");
-  exe_dir = (exe_dir_t *)dlsym(_dllHandle, "exe_dir");
-  found_exe_dir = (bool *)dlsym(_dllHandle, "found_exe_dir");
-  key_states = (key_states_t *)dlsym(_dllHandle, "key_states");
-  is_cutscene = (word *)dlsym(_dllHandle, "is_cutscene");
-  enable_quicksave_penalty = (byte *)dlsym(_dllHandle, "enable_quicksave_penalty");
-  is_restart_level = (word *)dlsym(_dllHandle, "is_restart_level");
-  last_loose_sound = (word *)dlsym(_dllHandle, "last_loose_sound");
-  window_ = (SDL_Window **)dlsym(_dllHandle, "window_");
-  enable_copyprot = (byte *)dlsym(_dllHandle, "enable_copyprot");
-  _cachedFilePointerTable = (cachedFilePointerTable_t*)dlsym(_dllHandle, "_cachedFilePointerTable");
-  _cachedFileBufferTable = (cachedFileBufferTable_t*)dlsym(_dllHandle, "_cachedFileBufferTable");
-  _cachedFileBufferSizes = (cachedFileBufferSizes_t*)dlsym(_dllHandle, "_cachedFileBufferSizes");
-  _cachedFilePathTable = (cachedFilePathTable_t*)dlsym(_dllHandle, "_cachedFilePathTable");
-  _cachedFileCounter = (cachedFileCounter_t*)dlsym(_dllHandle, "_cachedFileCounter");
-  fixes = (fixes_options_type**)dlsym(_dllHandle, "fixes");
-  copyprot_plac = (word *) dlsym(_dllHandle, "copyprot_plac");
-  renderer_ = (SDL_Renderer**) dlsym(_dllHandle, "renderer_");
-  target_texture = (SDL_Texture**) dlsym(_dllHandle, "target_texture");
-  jumped_through_mirror = (short*) dlsym(_dllHandle, "jumped_through_mirror");
-  can_guard_see_kid = (short*) dlsym(_dllHandle, "can_guard_see_kid");
-  levels_file = (levels_file_t*) dlsym(_dllHandle, "levels_file");
+    EXIT_WITH_ERROR("Could not load %s. Check that this library's path is included in the LD_LIBRARY_PATH environment variable. Try also running fewer instances per process and hosting several emulator contexts per instance instead (see SDLPopInstance::createContext).\n", libraryFile);
+
+  bindSymbols();
 }
 
 SDLPopInstance::~SDLPopInstance()
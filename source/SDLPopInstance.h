@@ -1,8 +1,15 @@
 #pragma once
 
 #include "config.h"
+#include "move.h"
 #include "types.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 extern const char* seqNames[];
@@ -63,6 +70,7 @@ typedef void (*update_screen_t)(void);
 typedef void (*__pascal do_simple_wait_t)(int timer_index);
 typedef void (*reset_level_unused_fields_t)(bool loading_clean_level);
 typedef void (*__pascal far load_room_links_t)(void);
+typedef void (*__pascal far loadkid_and_opp_t)(void);
 typedef void (*set_timer_length_t)(int timer_index, int length);
 typedef void (*__pascal far draw_level_first_t)(void);
 typedef void (*__pascal far play_level_t)(int level_number);
@@ -76,6 +84,7 @@ typedef void (*__pascal far check_can_guard_see_kid_t)(void);
 typedef void (*__pascal far check_mirror_t)(void);
 typedef void (*__pascal far init_copyprot_t)(void);
 typedef void (*__pascal far alter_mods_allrm_t)(void);
+typedef void (*__pascal far get_room_address_t)(int room);
 typedef void (*__pascal far start_replay_t)(void);
 typedef void (*__pascal far display_text_bottom_t)(const char near *text);
 typedef void (*__pascal far redraw_screen_t)(int drawing_different_room);
@@ -99,14 +108,227 @@ typedef char cachedFilePathTable_t[MAX_CACHED_FILES][POP_MAX_PATH];
 typedef size_t cachedFileCounter_t;
 typedef char levels_file_t[POP_MAX_PATH];
 
+// Symbols bound from the sdlPopLib, as (member type, symbol name). Binding is driven by this table,
+// which also declares the corresponding SDLPopInstance members
+#define SDLPOP_SYMBOLS(SYMBOL) \
+  /* Functions */ \
+  SYMBOL(restore_room_after_quick_load_t, restore_room_after_quick_load) \
+  SYMBOL(load_global_options_t, load_global_options) \
+  SYMBOL(check_mod_param_t, check_mod_param) \
+  SYMBOL(load_ingame_settings_t, load_ingame_settings) \
+  SYMBOL(turn_sound_on_off_t, turn_sound_on_off) \
+  SYMBOL(load_mod_options_t, load_mod_options) \
+  SYMBOL(apply_seqtbl_patches_t, apply_seqtbl_patches) \
+  SYMBOL(open_dat_t, open_dat) \
+  SYMBOL(parse_grmode_t, parse_grmode) \
+  SYMBOL(init_timer_t, init_timer) \
+  SYMBOL(parse_cmdline_sound_t, parse_cmdline_sound) \
+  SYMBOL(set_hc_pal_t, set_hc_pal) \
+  SYMBOL(rect_sthg_t, rect_sthg) \
+  SYMBOL(show_loading_t, show_loading) \
+  SYMBOL(set_joy_mode_t, set_joy_mode) \
+  SYMBOL(init_copyprot_dialog_t, init_copyprot_dialog) \
+  SYMBOL(init_record_replay_t, init_record_replay) \
+  SYMBOL(init_menu_t, init_menu) \
+  SYMBOL(prandom_t, prandom) \
+  SYMBOL(load_from_opendats_alloc_t, load_from_opendats_alloc) \
+  SYMBOL(set_pal_256_t, set_pal_256) \
+  SYMBOL(set_pal_t, set_pal) \
+  SYMBOL(load_sprites_from_file_t, load_sprites_from_file) \
+  SYMBOL(close_dat_t, close_dat) \
+  SYMBOL(init_lighting_t, init_lighting) \
+  SYMBOL(load_all_sounds_t, load_all_sounds) \
+  SYMBOL(hof_read_t, hof_read) \
+  SYMBOL(release_title_images_t, release_title_images) \
+  SYMBOL(free_optsnd_chtab_t, free_optsnd_chtab) \
+  SYMBOL(make_offscreen_buffer_t, make_offscreen_buffer) \
+  SYMBOL(load_kid_sprite_t, load_kid_sprite) \
+  SYMBOL(load_lev_spr_t, load_lev_spr) \
+  SYMBOL(load_level_t, load_level) \
+  SYMBOL(pos_guards_t, pos_guards) \
+  SYMBOL(clear_coll_rooms_t, clear_coll_rooms) \
+  SYMBOL(clear_saved_ctrl_t, clear_saved_ctrl) \
+  SYMBOL(do_startpos_t, do_startpos) \
+  SYMBOL(find_start_level_door_t, find_start_level_door) \
+  SYMBOL(check_sound_playing_t, check_sound_playing) \
+  SYMBOL(do_paused_t, do_paused) \
+  SYMBOL(idle_t, idle) \
+  SYMBOL(stop_sounds_t, stop_sounds) \
+  SYMBOL(show_copyprot_t, show_copyprot) \
+  SYMBOL(reset_timer_t, reset_timer) \
+  SYMBOL(free_peels_t, free_peels) \
+  SYMBOL(play_level_2_t, play_level_2) \
+  SYMBOL(timers_t, timers) \
+  SYMBOL(play_frame_t, play_frame) \
+  SYMBOL(draw_game_frame_t, draw_game_frame) \
+  SYMBOL(update_screen_t, update_screen) \
+  SYMBOL(do_simple_wait_t, do_simple_wait) \
+  SYMBOL(reset_level_unused_fields_t, reset_level_unused_fields) \
+  SYMBOL(load_room_links_t, load_room_links) \
+  SYMBOL(loadkid_and_opp_t, loadkid_and_opp) \
+  SYMBOL(set_timer_length_t, set_timer_length) \
+  SYMBOL(draw_level_first_t, draw_level_first) \
+  SYMBOL(play_level_t, play_level) \
+  SYMBOL(save_recorded_replay_t, save_recorded_replay) \
+  SYMBOL(start_recording_t, start_recording) \
+  SYMBOL(add_replay_move_t, add_replay_move) \
+  SYMBOL(process_trobs_t, process_trobs) \
+  SYMBOL(do_mobs_t, do_mobs) \
+  SYMBOL(check_skel_t, check_skel) \
+  SYMBOL(check_can_guard_see_kid_t, check_can_guard_see_kid) \
+  SYMBOL(check_mirror_t, check_mirror) \
+  SYMBOL(init_copyprot_t, init_copyprot) \
+  SYMBOL(alter_mods_allrm_t, alter_mods_allrm) \
+  SYMBOL(get_room_address_t, get_room_address) \
+  SYMBOL(start_replay_t, start_replay) \
+  SYMBOL(start_game_t, start_game) \
+  SYMBOL(display_text_bottom_t, display_text_bottom) \
+  SYMBOL(redraw_screen_t, redraw_screen) \
+  SYMBOL(draw_image_transp_vga_t, draw_image_transp_vga) \
+  /* State variables */ \
+  SYMBOL(char_type *, Kid) \
+  SYMBOL(char_type *, Guard) \
+  SYMBOL(char_type *, Char) \
+  SYMBOL(char_type *, Opp) \
+  SYMBOL(short *, trobs_count) \
+  SYMBOL(trobs_t *, trobs) \
+  SYMBOL(short *, mobs_count) \
+  SYMBOL(mobs_t *, mobs) \
+  SYMBOL(level_type *, level) \
+  SYMBOL(word *, drawn_room) \
+  SYMBOL(word *, room_L) \
+  SYMBOL(word *, room_R) \
+  SYMBOL(word *, loaded_room) \
+  SYMBOL(word *, leveldoor_open) \
+  SYMBOL(word *, hitp_curr) \
+  SYMBOL(word *, guardhp_curr) \
+  SYMBOL(word *, current_level) \
+  SYMBOL(word *, next_level) \
+  SYMBOL(word *, checkpoint) \
+  SYMBOL(word *, upside_down) \
+  SYMBOL(word *, exit_room_timer) \
+  SYMBOL(word *, hitp_max) \
+  SYMBOL(word *, hitp_beg_lev) \
+  SYMBOL(word *, grab_timer) \
+  SYMBOL(word *, holding_sword) \
+  SYMBOL(short *, united_with_shadow) \
+  SYMBOL(short *, pickup_obj_type) \
+  SYMBOL(word *, kid_sword_strike) \
+  SYMBOL(word *, offguard) \
+  SYMBOL(word *, have_sword) \
+  SYMBOL(word *, guardhp_max) \
+  SYMBOL(word *, demo_index) \
+  SYMBOL(short *, demo_time) \
+  SYMBOL(word *, curr_guard_color) \
+  SYMBOL(short *, guard_notice_timer) \
+  SYMBOL(word *, guard_skill) \
+  SYMBOL(word *, shadow_initialized) \
+  SYMBOL(word *, guard_refrac) \
+  SYMBOL(word *, justblocked) \
+  SYMBOL(word *, droppedout) \
+  SYMBOL(curr_row_coll_room_t *, curr_row_coll_room) \
+  SYMBOL(curr_row_coll_flags_t *, curr_row_coll_flags) \
+  SYMBOL(below_row_coll_room_t *, below_row_coll_room) \
+  SYMBOL(below_row_coll_flags_t *, below_row_coll_flags) \
+  SYMBOL(above_row_coll_room_t *, above_row_coll_room) \
+  SYMBOL(above_row_coll_flags_t *, above_row_coll_flags) \
+  SYMBOL(sbyte *, prev_collision_row) \
+  SYMBOL(word *, flash_color) \
+  SYMBOL(word *, flash_time) \
+  SYMBOL(word *, need_level1_music) \
+  SYMBOL(word *, is_screaming) \
+  SYMBOL(word *, is_feather_fall) \
+  SYMBOL(word *, last_loose_sound) \
+  SYMBOL(dword *, random_seed) \
+  SYMBOL(dword *, preserved_seed) \
+  SYMBOL(short *, rem_min) \
+  SYMBOL(word *, rem_tick) \
+  SYMBOL(sbyte *, control_x) \
+  SYMBOL(sbyte *, control_y) \
+  SYMBOL(sbyte *, control_shift) \
+  SYMBOL(sbyte *, control_forward) \
+  SYMBOL(sbyte *, control_backward) \
+  SYMBOL(sbyte *, control_up) \
+  SYMBOL(sbyte *, control_down) \
+  SYMBOL(sbyte *, control_shift2) \
+  SYMBOL(sbyte *, ctrl1_forward) \
+  SYMBOL(sbyte *, ctrl1_backward) \
+  SYMBOL(sbyte *, ctrl1_up) \
+  SYMBOL(sbyte *, ctrl1_down) \
+  SYMBOL(sbyte *, ctrl1_shift2) \
+  SYMBOL(dword *, curr_tick) \
+  SYMBOL(dat_type **, dathandle) \
+  SYMBOL(byte **, level_var_palettes) \
+  SYMBOL(word *, is_blind_mode) \
+  SYMBOL(word *, seed_was_init) \
+  SYMBOL(word *, need_drects) \
+  SYMBOL(int *, g_argc) \
+  SYMBOL(char ** *, g_argv) \
+  SYMBOL(surface_type **, current_target_surface) \
+  SYMBOL(SDL_Surface **, onscreen_surface_) \
+  SYMBOL(rect_type *, screen_rect) \
+  SYMBOL(word *, cheats_enabled) \
+  SYMBOL(word *, draw_mode) \
+  SYMBOL(word *, demo_mode) \
+  SYMBOL(int *, play_demo_level) \
+  SYMBOL(byte **, doorlink1_ad) \
+  SYMBOL(byte **, doorlink2_ad) \
+  SYMBOL(byte **, guard_palettes) \
+  SYMBOL(chtab_addrs_t *, chtab_addrs) \
+  SYMBOL(short *, start_level) \
+  SYMBOL(surface_type **, offscreen_surface) \
+  SYMBOL(rect_type *, rect_top) \
+  SYMBOL(word *, text_time_remaining) \
+  SYMBOL(word *, text_time_total) \
+  SYMBOL(word *, is_show_time) \
+  SYMBOL(word *, resurrect_time) \
+  SYMBOL(custom_options_type **, custom) \
+  SYMBOL(short *, next_sound) \
+  SYMBOL(short *, can_guard_see_kid) \
+  SYMBOL(short *, hitp_delta) \
+  SYMBOL(short *, guardhp_delta) \
+  SYMBOL(word *, different_room) \
+  SYMBOL(word *, next_room) \
+  SYMBOL(word *, is_guard_notice) \
+  SYMBOL(word *, need_full_redraw) \
+  SYMBOL(byte *, is_validate_mode) \
+  SYMBOL(exe_dir_t *, exe_dir) \
+  SYMBOL(bool *, found_exe_dir) \
+  SYMBOL(key_states_t *, key_states) \
+  SYMBOL(word *, is_cutscene) \
+  SYMBOL(byte *, enable_quicksave_penalty) \
+  SYMBOL(word *, is_restart_level) \
+  SYMBOL(SDL_Window **, window_) \
+  SYMBOL(byte *, enable_copyprot) \
+  SYMBOL(fixes_options_type **, fixes) \
+  SYMBOL(word *, copyprot_plac) \
+  SYMBOL(SDL_Renderer **, renderer_) \
+  SYMBOL(SDL_Texture **, target_texture) \
+  SYMBOL(short *, jumped_through_mirror) \
+  SYMBOL(levels_file_t *, levels_file) \
+  /* File cache variables */ \
+  SYMBOL(cachedFilePointerTable_t *, _cachedFilePointerTable) \
+  SYMBOL(cachedFileBufferTable_t *, _cachedFileBufferTable) \
+  SYMBOL(cachedFileBufferSizes_t *, _cachedFileBufferSizes) \
+  SYMBOL(cachedFilePathTable_t *, _cachedFilePathTable) \
+  SYMBOL(cachedFileCounter_t *, _cachedFileCounter)
+
 class SDLPopInstance
 {
   public:
   SDLPopInstance(const char* libraryFile, const bool multipleLibraries);
   ~SDLPopInstance();
 
-  // Initializes the sdlPop instance
-  void initialize(const bool useGUI);
+  // Initializes the sdlPop instance. Simulation-only instances (which cannot use GUI) skip loading sounds,
+  // and start levels without drawing or waiting for sounds and timers, producing the same game state
+  void initialize(const bool useGUI, const bool simulationOnly = false);
+
+  bool isSimulationOnly() const { return _isSimulationOnly; }
+
+  // Starts levels from the level data cached upon initialization, instead of loading them from the levels file.
+  // The level sprites of simulation-only instances are then cached per level number as well (and kept until
+  // the instance is destroyed). Enabled by default, and required by emulator contexts.
+  void setLevelCache(const bool useLevelCache);
 
   // Starts a given level
   void startLevel(const word level);
@@ -118,27 +340,147 @@ class SDLPopInstance
   void draw();
 
   // Perform a single move
+  void performMove(const Move move);
+
+  // Perform a single move given in solution file notation (parses it every time)
   void performMove(const std::string &move);
 
   // Advance a frame
   void advanceFrame();
 
+  // Conditions upon which advanceFrames() calls back, besides the frame interval
+  enum frameTrigger_t : uint32_t
+  {
+    TRIGGER_ROOM_CHANGE = 1 << 0,
+    TRIGGER_LEVEL_CHANGE = 1 << 1,
+    TRIGGER_HP_CHANGE = 1 << 2
+  };
+
+  // Performs a sequence of moves, advancing one frame for each. The callback receives the index of the move
+  // just performed, and is called every (frameInterval) moves (never, if 0), whenever any of the given triggers
+  // fires, and after the last move. Returning false from it stops the sequence. Returns the moves performed.
+  size_t advanceFrames(const Move *moves, const size_t moveCount, const size_t frameInterval, const std::function<bool(const size_t)> &callback, const uint32_t triggers = 0);
+
   // Print information about the current frame
   void printFrameInfo();
 
   // Function to transfer cache file contents to reduce pressure on I/O
   std::string serializeFileCache();
-  void deserializeFileCache(const std::string& cache);
+  void deserializeFileCache(const std::string_view cache);
+
+  // Check if exit door is open (as of the last level features update)
+  bool isLevelExitDoorOpen() const { return _levelFeatures.isExitDoorOpen; }
+
+  // Level features derived from the game state, for the current frame
+  struct gateFeature_t
+  {
+    word tileIdx;
+    byte state;    // Gate opening (level bg modifier)
+    bool isActive; // Whether the gate is currently moving
+  };
+
+  struct levelFeatures_t
+  {
+    bool isExitDoorOpen;
+    std::vector<gateFeature_t> gates;
+    std::vector<word> looseTiles; // Tiles still holding a loose floor
+  };
+
+  const levelFeatures_t &getLevelFeatures() const { return _levelFeatures; }
+
+  // Updates the level features. This is done upon every frame advance, level start and state load, so
+  // that all consumers share a single computation. Gate and loose tile positions are taken once per level
+  // number from the pristine level, so an update only goes over the trobs and those positions
+  void updateLevelFeatures();
+
+  // Gets the level struct as loaded by load_level() for a given level number, from the cache built upon initialization
+  const level_type &getPristineLevel(const word levelId) const;
+
+  // Creates a new instance in its own library namespace holding a copy of this instance's writable
+  // sdlPopLib memory, without running initialize(). Pointers into the sdlPopLib and into the code of
+  // other libraries are relocated to the clone's namespace. Pointers to the heap or to the data of other
+  // libraries are cleared, and the clone loads its own file cache, video buffers, palettes and sprites,
+  // as a warm start does. Only instances initialized without GUI can be cloned.
+  std::unique_ptr<SDLPopInstance> clone() const;
+
+  // Counts the words of this instance's writable sdlPopLib memory that hold the same heap pointer as the given
+  // instance does at the same position. Clones own all of their heap memory, so this is zero for them
+  size_t countSharedHeapPointers(const SDLPopInstance &other) const;
+
+  // Warm-start images hold the initialized sdlPopLib writable segments (with their pointers stored relative
+  // to the objects they point to), the file cache and the level cache, so a new process can resume from them
+  // instead of running initialize(). Heap resources (video buffers, palettes, sprites) are loaded again; sounds are not.
+  // initialize() uses them for headless instances when JAFFAR_WARM_START_IMAGE is set.
+  void saveWarmStartImage(const char *fileName) const;
+
+  // Returns false, leaving the instance untouched, if the image is missing or its key does not match
+  bool loadWarmStartImage(const char *fileName);
+
+  // Validity key of warm-start images: library build ID and LEVELS.DAT/PRINCE.DAT contents
+  uint64_t getWarmStartKey() const;
+
+  // Writable memory of a loaded library, excluding its read-only after relocation part
+  struct segment_t
+  {
+    char *ptr;
+    size_t size;
+  };
+
+  // Gets the writable data and bss segments of the sdlPopLib for this instance
+  std::vector<segment_t> getWritableSegments() const;
+
+  // Gets the words of the writable sdlPopLib memory that currently hold pointers into the heap
+  std::vector<uintptr_t *> getHeapPointers() const;
+
+  // Loads the sprites for the given level, or takes them from the cache. Like load_lev_spr, this sets the current and next level
+  void loadLevelSprites(const word levelId);
+
+  // Emulator contexts: each one holds its own copy of the writable sdlPopLib memory, which is swapped into
+  // the library when it becomes active. This way, a single library namespace can host any number of
+  // emulators, although only one of them runs at a time. The live memory is context 0. Heap resources
+  // (sprites, file cache) and rollback points are shared by all the contexts of an instance. Since the saved
+  // contexts point to the same sprites, these must never be freed: contexts are only available on simulation-only
+  // instances that use the level cache, whose sprites are kept for the lifetime of the instance.
 
-  // Check if exit door is open
-  bool isLevelExitDoorOpen();
+  // Creates a new context as a copy of the currently active one and returns its id. Must not be called while holding a context
+  size_t createContext();
+
+  // Switches to the given context and keeps other threads from switching until the returned lock is released
+  std::unique_lock<std::mutex> acquireContext(const size_t contextId);
+
+  size_t getActiveContext() const { return _activeContext; }
+  size_t getContextCount() const { return _contexts.size(); }
+
+  // Registers a writable memory region (e.g., a state copy run) to be covered by rollbacks
+  void addRollbackRegion(void *ptr, const size_t size);
+
+  // Takes a snapshot of the registered regions. Branching from a frame is then done by
+  // calling rollback() between candidate moves instead of reloading the whole state
+  void setRollbackPoint();
+
+  // Undoes the writes made to the registered regions since the last rollback point, restoring only
+  // the blocks that changed and reloading room links only when the drawn room or layout changed
+  void rollback();
+
+  // Fixups after the state items were written by a state load or a rollback: updates the level features, shows
+  // the kid's room and reloads the room links, unless the drawn room (as before the load) and the room links are
+  // unchanged and the room pointers still point to the drawn room
+  void finishStateLoad(const word prevDrawnRoom, const bool roomLinksChanged);
 
   // Storing previously drawn room
   word _prevDrawnRoom;
 
   // Functions to advance/reverse RNG state
-  unsigned int advanceRNGState(const unsigned int randomSeed);
-  unsigned int reverseRNGState(const unsigned int randomSeed);
+  static dword advanceRNGState(const dword randomSeed);
+  static dword reverseRNGState(const dword randomSeed);
+
+  // Advances/reverses the RNG state by the given number of steps, in O(log steps)
+  static dword advanceRNGState(const dword randomSeed, const uint64_t steps);
+  static dword reverseRNGState(const dword randomSeed, const uint64_t steps);
+
+  // Number of advances that takes the RNG from one state to another. The generator has a full period of 2^32,
+  // so every state is reachable from every other; the reverse distance is 2^32 minus this one (modulo 2^32)
+  static dword getRNGDistance(const dword initialSeed, const dword targetSeed);
 
   // IGT Timing functions
   size_t getElapsedMins();
@@ -163,209 +505,86 @@ class SDLPopInstance
   SDL_Surface* _shift2Surface;
 
 
+  // Index into seqNames of the sequence containing the given sequence table offset, in constant time
+  static int getSequenceId(const word seqOffset);
   int getKidSequenceId();
   int getGuardSequenceId();
 
-  // SDLPop Functions
-  restore_room_after_quick_load_t restore_room_after_quick_load;
-  load_global_options_t load_global_options;
-  check_mod_param_t check_mod_param;
-  load_ingame_settings_t load_ingame_settings;
-  turn_sound_on_off_t turn_sound_on_off;
-  load_mod_options_t load_mod_options;
-  apply_seqtbl_patches_t apply_seqtbl_patches;
-  open_dat_t open_dat;
-  parse_grmode_t parse_grmode;
-  init_timer_t init_timer;
-  parse_cmdline_sound_t parse_cmdline_sound;
-  set_hc_pal_t set_hc_pal;
-  rect_sthg_t rect_sthg;
-  show_loading_t show_loading;
-  set_joy_mode_t set_joy_mode;
-  init_copyprot_dialog_t init_copyprot_dialog;
-  init_record_replay_t init_record_replay;
-  init_menu_t init_menu;
-  prandom_t prandom;
-  load_from_opendats_alloc_t load_from_opendats_alloc;
-  set_pal_256_t set_pal_256;
-  set_pal_t set_pal;
-  load_sprites_from_file_t load_sprites_from_file;
-  close_dat_t close_dat;
-  init_lighting_t init_lighting;
-  load_all_sounds_t load_all_sounds;
-  hof_read_t hof_read;
-  release_title_images_t release_title_images;
-  free_optsnd_chtab_t free_optsnd_chtab;
-  make_offscreen_buffer_t make_offscreen_buffer;
-  load_kid_sprite_t load_kid_sprite;
-  load_lev_spr_t load_lev_spr;
-  load_level_t load_level;
-  pos_guards_t pos_guards;
-  clear_coll_rooms_t clear_coll_rooms;
-  clear_saved_ctrl_t clear_saved_ctrl;
-  do_startpos_t do_startpos;
-  find_start_level_door_t find_start_level_door;
-  check_sound_playing_t check_sound_playing;
-  do_paused_t do_paused;
-  idle_t idle;
-  stop_sounds_t stop_sounds;
-  show_copyprot_t show_copyprot;
-  reset_timer_t reset_timer;
-  free_peels_t free_peels;
-  play_level_2_t play_level_2;
-  timers_t timers;
-  play_frame_t play_frame;
-  draw_game_frame_t draw_game_frame;
-  update_screen_t update_screen;
-  do_simple_wait_t do_simple_wait;
-  reset_level_unused_fields_t reset_level_unused_fields;
-  load_room_links_t load_room_links;
-  set_timer_length_t set_timer_length;
-  draw_level_first_t draw_level_first;
-  play_level_t play_level;
-  save_recorded_replay_t save_recorded_replay;
-  start_recording_t start_recording;
-  add_replay_move_t add_replay_move;
-  process_trobs_t process_trobs;
-  do_mobs_t do_mobs;
-  check_skel_t check_skel;
-  check_can_guard_see_kid_t check_can_guard_see_kid;
-  check_mirror_t check_mirror;
-  init_copyprot_t init_copyprot;
-  alter_mods_allrm_t alter_mods_allrm;
-  start_replay_t start_replay;
-  start_game_t start_game;
-  display_text_bottom_t display_text_bottom;
-  redraw_screen_t redraw_screen;
-  draw_image_transp_vga_t draw_image_transp_vga;
-
-  // SDLPop State variables
-  char_type *Kid;     //
-  char_type *Guard;   //
-  char_type *Char;    //
-  char_type *Opp;     //
-  short *trobs_count; //
-  trobs_t *trobs;     //
-  short *mobs_count;  //
-  mobs_t *mobs;       //
-  level_type *level;  //
-  word *drawn_room;
-  word *leveldoor_open;
-  word *hitp_curr;
-  word *guardhp_curr;
-  word *current_level;
-  word *next_level;
-  word *checkpoint;
-  word *upside_down;
-  word *exit_room_timer;
-  word *hitp_max;
-  word *hitp_beg_lev;
-  word *grab_timer;
-  word *holding_sword;
-  short *united_with_shadow; //
-  short *pickup_obj_type;    //
-  word *kid_sword_strike;
-  word *offguard;
-  word *have_sword;
-  word *guardhp_max;
-  word *demo_index;
-  short *demo_time; //
-  word *curr_guard_color;
-  short *guard_notice_timer; //
-  word *guard_skill;
-  word *shadow_initialized;
-  word *guard_refrac;
-  word *justblocked;
-  word *droppedout;
-  curr_row_coll_room_t *curr_row_coll_room;
-  curr_row_coll_flags_t *curr_row_coll_flags;
-  below_row_coll_room_t *below_row_coll_room;
-  below_row_coll_flags_t *below_row_coll_flags;
-  above_row_coll_room_t *above_row_coll_room;
-  above_row_coll_flags_t *above_row_coll_flags;
-  sbyte *prev_collision_row;
-  word *flash_color;
-  word *flash_time;
-  word *need_level1_music;
-  word *is_screaming;
-  word *is_feather_fall;
-  word *last_loose_sound;
-  dword *random_seed;
-  dword *preserved_seed;
-  short *rem_min;
-  word *rem_tick;
-  sbyte *control_x;
-  sbyte *control_y;
-  sbyte *control_shift;
-  sbyte *control_forward;
-  sbyte *control_backward;
-  sbyte *control_up;
-  sbyte *control_down;
-  sbyte *control_shift2;
-  sbyte *ctrl1_forward;
-  sbyte *ctrl1_backward;
-  sbyte *ctrl1_up;
-  sbyte *ctrl1_down;
-  sbyte *ctrl1_shift2;
-  dword *curr_tick;
-  dat_type **dathandle;
-  byte **level_var_palettes;
-  word *is_blind_mode;
-  word *seed_was_init;
-  word *need_drects;
-  int *g_argc;
-  char ***g_argv;
-  surface_type **current_target_surface;
-  SDL_Surface **onscreen_surface_;
-  rect_type *screen_rect;
-  word *cheats_enabled;
-  word *draw_mode;
-  word *demo_mode;
-  int *play_demo_level;
-  byte **doorlink1_ad;
-  byte **doorlink2_ad;
-  byte **guard_palettes;
-  chtab_addrs_t *chtab_addrs;
-  short *start_level; //
-  surface_type **offscreen_surface;
-  rect_type *rect_top;
-  word *text_time_remaining;    //
-  word *text_time_total;        //
-  word *is_show_time;           //
-  word *resurrect_time;         //
-  custom_options_type **custom; //
-  short *next_sound;            //
-  short *can_guard_see_kid;     //
-  short *hitp_delta;            //
-  short *guardhp_delta;         //
-  word *different_room;         //
-  word *next_room;              //
-  word *is_guard_notice;        //
-  word *need_full_redraw;
-  byte *is_validate_mode;
-  exe_dir_t *exe_dir;
-  bool *found_exe_dir;
-  key_states_t *key_states;
-  word *is_cutscene;
-  bool isExitDoorOpen;
-  byte *enable_quicksave_penalty;
-  word *is_restart_level;
-  SDL_Window **window_;
-  byte* enable_copyprot;
-  fixes_options_type** fixes;
-  word* copyprot_plac;
-  SDL_Renderer** renderer_;
-  SDL_Texture** target_texture;
-  short *jumped_through_mirror;
-  levels_file_t* levels_file;
-
-  // File cache variables
-  cachedFilePointerTable_t* _cachedFilePointerTable;
-  cachedFileBufferTable_t* _cachedFileBufferTable;
-  cachedFileBufferSizes_t* _cachedFileBufferSizes;
-  cachedFilePathTable_t* _cachedFilePathTable;
-  cachedFileCounter_t* _cachedFileCounter;
+  // SDLPop functions and state variables
+  #define SDLPOP_DECLARE_SYMBOL(TYPE, NAME) TYPE NAME;
+  SDLPOP_SYMBOLS(SDLPOP_DECLARE_SYMBOL)
+  #undef SDLPOP_DECLARE_SYMBOL
+
+  // State items with no counterpart in the sdlPopLib. Kept per instance so that instances can run concurrently
+  char quick_control[9] = "........";
+  float replay_curr_tick = 0.0;
 
   private:
   void *_dllHandle;
+  std::string _libraryFile;
+
+  // Per-context copies of the writable sdlPopLib memory and of the instance-side state
+  struct context_t
+  {
+    std::string segmentData;
+    word prevDrawnRoom;
+    char quickControl[sizeof(quick_control)];
+    float replayCurrTick;
+    std::string move;
+  };
+  std::vector<context_t> _contexts;
+  std::vector<segment_t> _contextSegments;
+  size_t _activeContext = 0;
+  std::mutex _contextMutex;
+
+  // Copies the live memory into a context and back
+  void storeContext(context_t &context) const;
+  void restoreContext(const context_t &context);
+
+  // Makes the given context active, storing the live memory into the previously active one. Requires holding _contextMutex
+  void switchContext(const size_t contextId);
+
+  // Whether this instance was initialized for simulation only
+  bool _isSimulationOnly = false;
+
+  // Game state side effects of restore_room_after_quick_load() and draw_level_first(), without drawing
+  void restoreRoomWithoutDrawing();
+
+  // Level features for the current frame, and the level whose gate and loose tile positions were taken
+  levelFeatures_t _levelFeatures;
+  word _featureLevel = (word)-1;
+  std::vector<word> _gateTiles;
+  std::vector<word> _looseTileCandidates;
+
+  // Whether level data and sprites are cached, and the cached level sprite tables per level number
+  bool _useLevelCache = true;
+  std::map<word, std::vector<chtab_type *>> _levelSprites;
+
+  // Loads the heap-backed resources (video buffers, palettes and sprites) again, after the pointers to them
+  // were cleared by a warm start or a clone. Sounds are not loaded
+  void reloadHeapResources();
+
+  // Binds all the symbols in the table. They are resolved only once per library file and then
+  // rebased for every other namespace the library gets loaded into
+  void bindSymbols();
+
+  // Cache of pristine level structs per level number
+  std::map<word, level_type> _pristineLevels;
+
+  // Loads every level into the cache, leaving the sdlPopLib memory as it was
+  void buildLevelCache();
+
+  // Does what load_level() does, taking the level from the cache
+  void loadCachedLevel();
+
+  // Memory regions covered by rollbacks and their contents at the last rollback point
+  struct rollbackRegion_t
+  {
+    char *ptr;
+    size_t size;
+    size_t offset;
+  };
+  std::vector<rollbackRegion_t> _rollbackRegions;
+  std::string _rollbackData;
+  decltype(level_type::roomlinks) _rollbackRoomLinks;
 };
@@ -0,0 +1,94 @@
+#include "batch.h"
+#include "utils.h"
+#include <chrono>
+#include <sched.h>
+
+StateBatch::StateBatch(const char *libraryFile, const size_t instanceCount, const std::string_view saveString, const bool simulationOnly)
+{
+  if (instanceCount == 0) EXIT_WITH_ERROR("[Error] State batch requires at least one SDLPop instance.\n");
+
+  _frameCount = 0;
+  _elapsedSeconds = 0.0;
+
+  // Only the first instance is initialized. The rest are clones of it, each in its own library namespace,
+  // so they never share sdlPopLib globals with any other instance in the process
+  _instances.emplace_back(new SDLPopInstance(libraryFile, true));
+  _instances[0]->initialize(false, simulationOnly);
+  for (size_t i = 1; i < instanceCount; i++) _instances.push_back(_instances[0]->clone());
+
+  // State handlers are created sequentially, since loading a state may rely on file I/O. Every step starts
+  // from a frame close to the one the instance just left, so only the items that differ get restored
+  for (size_t i = 0; i < instanceCount; i++)
+  {
+    _states.emplace_back(new State(_instances[i].get(), saveString));
+    _states[i]->setDifferentialLoad(true);
+  }
+
+  // Getting the CPUs granted to the process (e.g., by taskset or a container), for pinning
+  cpu_set_t allowedCpus;
+  if (sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus) == 0)
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &allowedCpus)) _cpuIds.push_back(cpu);
+}
+
+void StateBatch::run(std::vector<Step> &steps)
+{
+  const size_t instanceCount = _instances.size();
+
+  // Exceptions cannot leave the parallel region, so the first error is kept and reported after it
+  std::string errorMessage;
+  size_t errorStepId = 0;
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+
+  // Instance t is driven by thread t only (or a single thread, if fewer are granted), taking every (instance count)-th step
+  #pragma omp parallel for num_threads(instanceCount) schedule(static, 1)
+  for (size_t instanceId = 0; instanceId < instanceCount; instanceId++)
+  {
+    // OpenMP reuses its threads for later parallel regions, so each one gets its own affinity back afterwards
+    cpu_set_t threadCpus;
+    const bool isPinned = _cpuIds.empty() == false && sched_getaffinity(0, sizeof(threadCpus), &threadCpus) == 0;
+    if (isPinned)
+    {
+      cpu_set_t threadCpu;
+      CPU_ZERO(&threadCpu);
+      CPU_SET(_cpuIds[instanceId % _cpuIds.size()], &threadCpu);
+      sched_setaffinity(0, sizeof(threadCpu), &threadCpu);
+    }
+
+    SDLPopInstance &sdlPop = *_instances[instanceId];
+    State &state = *_states[instanceId];
+
+    for (size_t i = instanceId; i < steps.size(); i += instanceCount)
+    {
+      auto &step = steps[i];
+      try
+      {
+        state.loadState(step.frameData);
+        sdlPop.performMove(step.move);
+        sdlPop.advanceFrame();
+        state.saveState(step.resultData);
+        step.resultHash = state.computeHash();
+      }
+      catch (const std::exception &err)
+      {
+        #pragma omp critical
+        if (errorMessage.empty() || i < errorStepId)
+        {
+          errorMessage = err.what();
+          errorStepId = i;
+        }
+        break;
+      }
+    }
+
+    if (isPinned) sched_setaffinity(0, sizeof(threadCpus), &threadCpus);
+  }
+
+  auto tf = std::chrono::high_resolution_clock::now();
+
+  if (errorMessage.empty() == false) EXIT_WITH_ERROR("[Error] Batch step %lu failed: %s", errorStepId, errorMessage.c_str());
+
+  _frameCount += steps.size();
+  _elapsedSeconds += std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+}
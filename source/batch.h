@@ -0,0 +1,52 @@
+#pragma once
+
+#include "SDLPopInstance.h"
+#include "state.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs load -> move -> advance -> save -> hash over many frames at once, spread across a set of
+// SDLPop instances. Each instance lives in its own library namespace and is always driven by the
+// same OpenMP thread, pinned to its own CPU while a run lasts, so no instance is ever touched by two threads.
+class StateBatch
+{
+  public:
+  // A single step to perform: the frame to start from, the move to apply, and where to store the
+  // resulting frame (a buffer of _FRAME_DATA_SIZE bytes, e.g., a StateArena slot) and its hash
+  struct Step
+  {
+    std::string_view frameData;
+    Move move;
+    char *resultData;
+    uint64_t resultHash;
+  };
+
+  // Creates and initializes the given number of instances (simulation-only ones, if requested), starting
+  // them from the given savefile contents
+  StateBatch(const char *libraryFile, const size_t instanceCount, const std::string_view saveString, const bool simulationOnly = false);
+
+  // Performs all the given steps. Step i is run by instance (i % instance count). Errors raised by any
+  // step are reported once all threads are done
+  void run(std::vector<Step> &steps);
+
+  size_t getInstanceCount() const { return _instances.size(); }
+
+  // Aggregate statistics over all the runs performed so far
+  size_t getFrameCount() const { return _frameCount; }
+  double getElapsedSeconds() const { return _elapsedSeconds; }
+  double getFramesPerSecond() const { return _elapsedSeconds > 0.0 ? (double)_frameCount / _elapsedSeconds : 0.0; }
+
+  private:
+  std::vector<std::unique_ptr<SDLPopInstance>> _instances;
+  std::vector<std::unique_ptr<State>> _states;
+
+  // CPUs the process may run on, which instance threads are pinned to in turn
+  std::vector<int> _cpuIds;
+
+  size_t _frameCount;
+  double _elapsedSeconds;
+};
@@ -0,0 +1,515 @@
+#include "argparse.hpp"
+#include "batch.h"
+#include "common.h"
+#include "segmentSnapshot.h"
+#include "state.h"
+#include "stateArena.h"
+#include "utils.h"
+#include <chrono>
+#include <dlfcn.h>
+#include <map>
+#include <memory>
+
+// Runs the given function the requested number of times and returns the operations per second
+template <typename F>
+double measureOpsPerSecond(const size_t iterations, F function)
+{
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < iterations; i++) function();
+  auto tf = std::chrono::high_resolution_clock::now();
+  double elapsedSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+  return (double)iterations / elapsedSeconds;
+}
+
+// Compares per-item state copies against the coalesced copy runs
+void benchmarkStateCopy(State &state, const std::string &saveString, const size_t iterations)
+{
+  const auto &items = state.getItems();
+  const auto &copyRuns = state.getCopyRuns();
+  std::string frameData = saveString;
+
+  printf("[Jaffar] State schema: %lu items, %lu copy runs.\n", items.size(), copyRuns.size());
+
+  double itemLoadOps = measureOpsPerSecond(iterations, [&]() {
+    size_t curPos = 0;
+    for (const auto &item : items)
+    {
+      memcpy(item.ptr, &frameData.c_str()[curPos], item.size);
+      curPos += item.size;
+    }
+  });
+
+  double runLoadOps = measureOpsPerSecond(iterations, [&]() {
+    for (const auto &run : copyRuns) memcpy(run.ptr, &frameData.c_str()[run.offset], run.size);
+  });
+
+  double itemSaveOps = measureOpsPerSecond(iterations, [&]() {
+    std::string res;
+    res.reserve(_FRAME_DATA_SIZE);
+    for (const auto &item : items) res.append(reinterpret_cast<const char *>(item.ptr), item.size);
+    frameData[0] = res[0];
+  });
+
+  double runSaveOps = measureOpsPerSecond(iterations, [&]() {
+    std::string res = state.saveState();
+    frameData[0] = res[0];
+  });
+
+  // Saving into arena slots, cycling through a working set of states
+  StateArena arena;
+  std::vector<char *> slots;
+  for (size_t i = 0; i < 1024; i++) slots.push_back(arena.getSlot(arena.allocate()));
+  size_t slotIdx = 0;
+  double arenaSaveOps = measureOpsPerSecond(iterations, [&]() { state.saveState(slots[slotIdx++ % slots.size()]); });
+
+  double fullLoadOps = measureOpsPerSecond(iterations, [&]() { state.loadState(saveString); });
+
+  printf("[Jaffar] Load (per-item loop):  %12.0f ops/s\n", itemLoadOps);
+  printf("[Jaffar] Load (copy runs):      %12.0f ops/s (%.2fx)\n", runLoadOps, runLoadOps / itemLoadOps);
+  printf("[Jaffar] Save (per-item loop):  %12.0f ops/s\n", itemSaveOps);
+  printf("[Jaffar] Save (copy runs):      %12.0f ops/s (%.2fx)\n", runSaveOps, runSaveOps / itemSaveOps);
+  printf("[Jaffar] Save (arena slots):    %12.0f ops/s (%.2fx)\n", arenaSaveOps, arenaSaveOps / itemSaveOps);
+  printf("[Jaffar] State::loadState:      %12.0f ops/s\n", fullLoadOps);
+}
+
+// Compares hashing the live state against saving it and hashing the frame data
+void benchmarkStateHash(State &state, const size_t iterations)
+{
+  uint64_t checksum = 0;
+
+  double saveHashOps = measureOpsPerSecond(iterations, [&]() {
+    std::string frameData = state.saveState();
+    checksum ^= hashBuffer(frameData.data(), frameData.size());
+  });
+
+  double liveHashOps = measureOpsPerSecond(iterations, [&]() { checksum ^= state.computeHash(); });
+
+  printf("[Jaffar] Hash (save + hash):    %12.0f ops/s\n", saveHashOps);
+  printf("[Jaffar] State::computeHash:    %12.0f ops/s (%.2fx)\n", liveHashOps, liveHashOps / saveHashOps);
+  printf("[Jaffar] Hash checksum: 0x%016lX\n", checksum);
+}
+
+// Compares applying moves from their solution file notation against the packed move type
+void benchmarkMoveInput(SDLPopInstance &sdlPop, const size_t iterations)
+{
+  const std::vector<std::string> candidateMoves = {".", "S", "U", "L", "R", "D", "LU", "RU"};
+  std::vector<Move> packedMoves;
+  for (const auto &move : candidateMoves) packedMoves.push_back(parseMove(move));
+
+  size_t moveIdx = 0;
+  double stringOps = measureOpsPerSecond(iterations, [&]() { sdlPop.performMove(candidateMoves[moveIdx++ % candidateMoves.size()]); });
+
+  moveIdx = 0;
+  double packedOps = measureOpsPerSecond(iterations, [&]() { sdlPop.performMove(packedMoves[moveIdx++ % packedMoves.size()]); });
+
+  printf("[Jaffar] Move (string):         %12.0f ops/s\n", stringOps);
+  printf("[Jaffar] Move (packed):         %12.0f ops/s (%.2fx)\n", packedOps, packedOps / stringOps);
+}
+
+// Compares full and differential loads when going back to a base frame after advancing from it, and checks
+// that both leave the whole writable sdlPopLib memory the same, both right after loading and one frame later
+void benchmarkDifferentialLoad(SDLPopInstance &sdlPop, State &state, const std::string &saveString, const size_t iterations)
+{
+  const std::vector<std::string> candidateMoves = {".", "S", "U", "L", "R", "D", "LU", "RU"};
+  SegmentSnapshot snapshot(&sdlPop);
+
+  for (size_t i = 0; i < candidateMoves.size(); i++)
+  {
+    std::string results[2];
+    for (const bool differentialLoad : {false, true})
+    {
+      // Taking the instance somewhere else before going back to the base frame
+      state.setDifferentialLoad(false);
+      state.loadState(saveString);
+      for (size_t frame = 0; frame < 30; frame++)
+      {
+        sdlPop.performMove(candidateMoves[(i + frame) % candidateMoves.size()]);
+        sdlPop.advanceFrame();
+      }
+
+      state.setDifferentialLoad(differentialLoad);
+      state.loadState(saveString);
+      results[differentialLoad] = snapshot.save();
+      sdlPop.performMove(candidateMoves[i]);
+      sdlPop.advanceFrame();
+      results[differentialLoad] += snapshot.save();
+    }
+
+    if (results[0] != results[1]) EXIT_WITH_ERROR("[Error] Differential load of the base frame after move %s differs from a full load.\n", candidateMoves[i].c_str());
+  }
+
+  size_t moveIdx = 0;
+  auto stepAndReload = [&]() {
+    sdlPop.performMove(candidateMoves[moveIdx++ % candidateMoves.size()]);
+    sdlPop.advanceFrame();
+    state.loadState(saveString);
+  };
+
+  state.setDifferentialLoad(false);
+  double fullLoadOps = measureOpsPerSecond(iterations, stepAndReload);
+  state.setDifferentialLoad(true);
+  double diffLoadOps = measureOpsPerSecond(iterations, stepAndReload);
+  state.setDifferentialLoad(false);
+
+  printf("[Jaffar] Step + load (full):    %12.0f ops/s\n", fullLoadOps);
+  printf("[Jaffar] Step + load (diff):    %12.0f ops/s (%.2fx)\n", diffLoadOps, diffLoadOps / fullLoadOps);
+}
+
+// Compares expanding candidate moves from a base frame by reloading it against rolling back
+void benchmarkBranchExpansion(SDLPopInstance &sdlPop, State &state, const std::string &saveString, const size_t iterations)
+{
+  const std::vector<std::string> candidateMoves = {".", "S", "U", "L", "R", "D", "LU", "RU"};
+
+  double reloadOps = measureOpsPerSecond(iterations, [&]() {
+    for (size_t i = 0; i < candidateMoves.size(); i++)
+    {
+      state.loadState(saveString);
+      sdlPop.performMove(candidateMoves[i]);
+      sdlPop.advanceFrame();
+    }
+  });
+
+  state.loadState(saveString);
+  sdlPop.setRollbackPoint();
+  double rollbackOps = measureOpsPerSecond(iterations, [&]() {
+    for (size_t i = 0; i < candidateMoves.size(); i++)
+    {
+      sdlPop.performMove(candidateMoves[i]);
+      sdlPop.advanceFrame();
+      sdlPop.rollback();
+    }
+  });
+
+  // Both expansions must produce the same full states, not just the same hashes
+  for (size_t i = 0; i < candidateMoves.size(); i++)
+  {
+    state.loadState(saveString);
+    sdlPop.performMove(candidateMoves[i]);
+    sdlPop.advanceFrame();
+    const std::string reloadState = state.saveState();
+
+    state.loadState(saveString);
+    sdlPop.setRollbackPoint();
+    sdlPop.performMove(candidateMoves[0]);
+    sdlPop.advanceFrame();
+    sdlPop.rollback();
+    sdlPop.performMove(candidateMoves[i]);
+    sdlPop.advanceFrame();
+    const std::string rollbackState = state.saveState();
+
+    if (reloadState != rollbackState) EXIT_WITH_ERROR("[Error] Rollback expansion of move '%s' produced a different state than reloading.\n", candidateMoves[i].c_str());
+  }
+
+  printf("[Jaffar] Expansion (reload):    %12.0f frames/s\n", reloadOps * candidateMoves.size());
+  printf("[Jaffar] Expansion (rollback):  %12.0f frames/s (%.2fx)\n", rollbackOps * candidateMoves.size(), rollbackOps / reloadOps);
+}
+
+// Runs several emulator contexts on the same instance, each one repeating a different move, and
+// checks that they end up in the same state as running them one after the other from scratch
+void benchmarkContexts(SDLPopInstance &sdlPop, State &state, const std::string &saveString, const size_t contextCount, const size_t iterations)
+{
+  const std::vector<std::string> candidateMoves = {".", "S", "U", "L", "R", "D", "LU", "RU"};
+  const size_t frameCount = std::max(iterations / std::max(contextCount, (size_t)1), (size_t)1);
+
+  state.loadState(saveString);
+  std::vector<size_t> contextIds = {0};
+  while (contextIds.size() < contextCount) contextIds.push_back(sdlPop.createContext());
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (size_t frame = 0; frame < frameCount; frame++)
+    for (size_t i = 0; i < contextIds.size(); i++)
+    {
+      const auto lock = sdlPop.acquireContext(contextIds[i]);
+      sdlPop.performMove(candidateMoves[i % candidateMoves.size()]);
+      sdlPop.advanceFrame();
+    }
+  auto tf = std::chrono::high_resolution_clock::now();
+  double elapsedSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+
+  std::vector<uint64_t> contextHashes;
+  for (const auto contextId : contextIds)
+  {
+    const auto lock = sdlPop.acquireContext(contextId);
+    contextHashes.push_back(state.computeHash());
+  }
+
+  const auto lock = sdlPop.acquireContext(0);
+  for (size_t i = 0; i < contextIds.size(); i++)
+  {
+    state.loadState(saveString);
+    for (size_t frame = 0; frame < frameCount; frame++)
+    {
+      sdlPop.performMove(candidateMoves[i % candidateMoves.size()]);
+      sdlPop.advanceFrame();
+    }
+    if (state.computeHash() != contextHashes[i]) EXIT_WITH_ERROR("[Error] Context %lu ended in a different state than running it on its own.\n", contextIds[i]);
+  }
+
+  printf("[Jaffar] Contexts (%3lu):         %12.0f frames/s (one switch per frame)\n", contextIds.size(), (double)(frameCount * contextIds.size()) / elapsedSeconds);
+}
+
+// Measures the time to create ready-to-use SDLPop instances in their own library namespaces,
+// either by loading and initializing them or by cloning an already initialized one
+void benchmarkConstruction(const SDLPopInstance &sdlPop, const size_t instanceCount)
+{
+  std::vector<std::unique_ptr<SDLPopInstance>> instances;
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < instanceCount; i++) instances.emplace_back(new SDLPopInstance("libsdlPopLib.so", true));
+  auto t1 = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < instanceCount; i++) instances[i]->initialize(false);
+  auto t2 = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < instanceCount; i++) instances.push_back(sdlPop.clone());
+  auto t3 = std::chrono::high_resolution_clock::now();
+
+  // Clones must not hold on to any of the source's heap memory, since their allocator would free it
+  for (size_t i = instanceCount; i < instances.size(); i++)
+  {
+    const size_t sharedPointers = instances[i]->countSharedHeapPointers(sdlPop);
+    if (sharedPointers > 0) EXIT_WITH_ERROR("[Error] Clone %lu holds %lu heap pointers of the instance it was cloned from.\n", i - instanceCount, sharedPointers);
+  }
+
+  double constructionMillis = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() * 1.0e-6 / (double)instanceCount;
+  double initializationMillis = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() * 1.0e-6 / (double)instanceCount;
+  double cloneMillis = std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count() * 1.0e-6 / (double)instanceCount;
+
+  printf("[Jaffar] Construction:          %12.3f ms/instance (%lu instances)\n", constructionMillis, instanceCount);
+  printf("[Jaffar] Initialization:        %12.3f ms/instance\n", initializationMillis);
+  printf("[Jaffar] Clone:                 %12.3f ms/instance (%.2fx speedup over construction + initialization)\n", cloneMillis, (constructionMillis + initializationMillis) / cloneMillis);
+}
+
+// Measures the aggregate stepping throughput of a multi-instance batch, checking its results against the single instance
+void benchmarkBatch(SDLPopInstance &sdlPop, State &state, const std::string &saveString, const size_t instanceCount, const size_t iterations)
+{
+  const std::vector<std::string> candidateMoves = {".", "S", "U", "L", "R", "D", "LU", "RU"};
+  const size_t batchSize = std::min(iterations, (size_t)4096);
+
+  // Expected results, from the benchmark instance
+  std::vector<uint64_t> expectedHashes;
+  for (const auto &move : candidateMoves)
+  {
+    state.loadState(saveString);
+    sdlPop.performMove(move);
+    sdlPop.advanceFrame();
+    expectedHashes.push_back(state.computeHash());
+  }
+
+  StateBatch batch("libsdlPopLib.so", instanceCount, saveString);
+
+  StateArena resultArena;
+  std::vector<StateBatch::Step> steps(batchSize);
+  for (size_t i = 0; i < batchSize; i++) steps[i] = {saveString, parseMove(candidateMoves[i % candidateMoves.size()]), resultArena.getSlot(resultArena.allocate()), 0};
+
+  for (size_t i = 0; i < iterations; i += batchSize)
+  {
+    batch.run(steps);
+    for (size_t j = 0; j < batchSize; j++)
+      if (steps[j].resultHash != expectedHashes[j % candidateMoves.size()]) EXIT_WITH_ERROR("[Error] Batch step %lu produced a different state than the single instance.\n", j);
+  }
+
+  printf("[Jaffar] Batch (%3lu instances): %12.0f frames/s\n", batch.getInstanceCount(), batch.getFramesPerSecond());
+}
+
+// Measures the size and throughput of the compact (level diff) state encoding
+void benchmarkCompactState(const SDLPopInstance &sdlPop, const std::string &saveString, const size_t iterations)
+{
+  std::string compactData;
+  std::string frameData = saveString;
+
+  double encodeOps = measureOpsPerSecond(iterations, [&]() { State::encodeCompactState(sdlPop, saveString.data(), compactData); });
+  double decodeOps = measureOpsPerSecond(iterations, [&]() { State::decodeCompactState(sdlPop, compactData, &frameData[0]); });
+
+  if (frameData != saveString) EXIT_WITH_ERROR("[Error] Compact state does not decode into the original frame data.\n");
+
+  printf("[Jaffar] Compact state size:    %12lu bytes (%.2fx smaller)\n", compactData.size(), (double)_FRAME_DATA_SIZE / (double)compactData.size());
+  printf("[Jaffar] Compact encode:        %12.0f ops/s\n", encodeOps);
+  printf("[Jaffar] Compact decode:        %12.0f ops/s\n", decodeOps);
+}
+
+// Compares the whole-segment snapshots against the item map, both for full copies and for rewinding after a frame advance
+void benchmarkSegmentSnapshot(SDLPopInstance &sdlPop, State &state, const std::string &saveString, const size_t iterations)
+{
+  SegmentSnapshot snapshot(&sdlPop, true);
+  std::string frameData = saveString;
+
+  state.loadState(saveString);
+  const std::string startFrame = state.saveState();
+  std::string snapshotData = snapshot.save();
+
+  double itemSaveOps = measureOpsPerSecond(iterations, [&]() { state.saveState(&frameData[0]); });
+  double itemLoadOps = measureOpsPerSecond(iterations, [&]() { state.loadState(saveString); });
+  double segmentSaveOps = measureOpsPerSecond(iterations, [&]() { snapshot.save(&snapshotData[0]); });
+  double segmentLoadOps = measureOpsPerSecond(iterations, [&]() { snapshot.load(snapshotData.data()); });
+
+  // Advancing a frame and going back to the starting one
+  double itemRewindOps = measureOpsPerSecond(iterations, [&]() {
+    sdlPop.performMove("R");
+    sdlPop.advanceFrame();
+    state.loadState(saveString);
+  });
+
+  size_t rewindBytes = 0;
+  snapshot.load(snapshotData.data());
+  snapshot.setRewindPoint();
+  double segmentRewindOps = measureOpsPerSecond(iterations, [&]() {
+    sdlPop.performMove("R");
+    sdlPop.advanceFrame();
+    snapshot.rewind();
+    rewindBytes += snapshot.getLastRewindSize();
+  });
+
+  if (state.saveState() != startFrame) EXIT_WITH_ERROR("[Error] Segment snapshot rewind did not go back to the starting state.\n");
+
+  const double snapshotMB = (double)snapshot.getSize() / (1024.0 * 1024.0);
+  printf("[Jaffar] Segment snapshot size: %12lu bytes (%.1fx the item map)\n", snapshot.getSize(), (double)snapshot.getSize() / (double)_FRAME_DATA_SIZE);
+  printf("[Jaffar] Save (item map):       %12.0f ops/s\n", itemSaveOps);
+  printf("[Jaffar] Save (segments):       %12.0f ops/s (%.2fx, %.0f MB/s)\n", segmentSaveOps, segmentSaveOps / itemSaveOps, segmentSaveOps * snapshotMB);
+  printf("[Jaffar] Load (item map):       %12.0f ops/s\n", itemLoadOps);
+  printf("[Jaffar] Load (segments):       %12.0f ops/s (%.2fx, %.0f MB/s)\n", segmentLoadOps, segmentLoadOps / itemLoadOps, segmentLoadOps * snapshotMB);
+  printf("[Jaffar] Rewind (item map):     %12.0f frames/s\n", itemRewindOps);
+  printf("[Jaffar] Rewind (segments):     %12.0f frames/s (%.2fx, %s, %.0f bytes/rewind)\n", segmentRewindOps, segmentRewindOps / itemRewindOps,
+         snapshot.isDirtyTrackingEnabled() ? "dirty pages" : "whole segments", (double)rewindBytes / (double)iterations);
+}
+
+// Checks the curated item map against whole-segment snapshots: the same frame is reached by loading the item
+// map state on top of an unrelated one and by restoring the exact snapshot, then the memory is compared after
+// advancing from both. Differing bytes are reported per sdlPopLib symbol.
+void validateItemMap(SDLPopInstance &sdlPop, State &state, const std::string &saveString)
+{
+  const std::vector<std::string> candidateMoves = {".", "S", "U", "L", "R", "D", "LU", "RU"};
+  SegmentSnapshot snapshot(&sdlPop);
+
+  state.loadState(saveString);
+  const std::string exactData = snapshot.save();
+
+  std::map<std::string, size_t> differingBytes;
+  size_t totalDifferingBytes = 0;
+  for (const auto &move : candidateMoves)
+  {
+    // Taking the instance somewhere else before loading the item map state
+    for (size_t i = 0; i < 60; i++)
+    {
+      sdlPop.performMove(candidateMoves[i % candidateMoves.size()]);
+      sdlPop.advanceFrame();
+    }
+    state.loadState(saveString);
+    sdlPop.performMove(move);
+    sdlPop.advanceFrame();
+    const std::string itemMapResult = snapshot.save();
+
+    snapshot.load(exactData.data());
+    sdlPop.performMove(move);
+    sdlPop.advanceFrame();
+    const std::string exactResult = snapshot.save();
+
+    for (size_t pos = 0; pos < exactResult.size(); pos++)
+    {
+      if (itemMapResult[pos] == exactResult[pos]) continue;
+      totalDifferingBytes++;
+
+      Dl_info info;
+      const char *address = snapshot.getAddress(pos);
+      if (address == nullptr) differingBytes["(instance state)"]++;
+      else if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) differingBytes[info.dli_sname]++;
+      else differingBytes["(unknown)"]++;
+    }
+  }
+
+  printf("[Jaffar] Item map validation:   %12lu differing bytes over %lu moves\n", totalDifferingBytes, candidateMoves.size());
+  for (const auto &entry : differingBytes) printf("[Jaffar]  + %-28s %lu bytes\n", entry.first.c_str(), entry.second);
+}
+
+int main(int argc, char *argv[])
+{
+  // Defining arguments
+  argparse::ArgumentParser program("jaffar-bench", JAFFAR_VERSION);
+
+  program.add_argument("savFile")
+    .help("Specifies the path to the SDLPop savefile (.sav) to use for the benchmarks.")
+    .required();
+
+  program.add_argument("--instances")
+    .help("Number of SDLPop instances to use in the batch stepping benchmark.")
+    .default_value(std::string("4"));
+
+  program.add_argument("--contexts")
+    .help("Number of emulator contexts to run on a single SDLPop instance in the context switching benchmark.")
+    .default_value(std::string("32"));
+
+  program.add_argument("--iterations")
+    .help("Number of repetitions for each measured operation.")
+    .default_value(std::string("100000"));
+
+  // Parsing command line
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    fprintf(stderr, "[Jaffar] Error parsing command line arguments: %s\n%s", err.what(), program.help().str().c_str());
+    exit(-1);
+  }
+
+  // Getting iteration count
+  const size_t iterations = std::stoul(program.get<std::string>("--iterations"));
+
+  // Getting batch instance count
+  const size_t instanceCount = std::stoul(program.get<std::string>("--instances"));
+
+  // Getting emulator context count
+  const size_t contextCount = std::stoul(program.get<std::string>("--contexts"));
+
+  // Getting savefile path
+  std::string saveFilePath = program.get<std::string>("savFile");
+
+  // Loading save file contents
+  std::string saveString;
+  bool status = loadStringFromFile(saveString, saveFilePath.c_str());
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not load save state from file: %s\n", saveFilePath.c_str());
+
+  // Initializing benchmark SDLPop Instance
+  SDLPopInstance benchSDLPop("libsdlPopLib.so", false);
+  benchSDLPop.initialize(false);
+
+  // Initializing State Handler
+  State benchState(&benchSDLPop, saveString);
+
+  printf("[Jaffar] Running state load/save benchmark (%lu iterations)...\n", iterations);
+  benchmarkStateCopy(benchState, saveString, iterations);
+
+  printf("[Jaffar] Running state hash benchmark (%lu iterations)...\n", iterations);
+  benchmarkStateHash(benchState, iterations);
+
+  printf("[Jaffar] Running compact state benchmark (%lu iterations)...\n", iterations);
+  benchmarkCompactState(benchSDLPop, saveString, iterations);
+
+  printf("[Jaffar] Running move input benchmark (%lu iterations)...\n", iterations);
+  benchmarkMoveInput(benchSDLPop, iterations);
+
+  // Simulation-only instance in its own namespace, whose cached sprites stay put across level changes
+  SDLPopInstance simSDLPop("libsdlPopLib.so", true);
+  simSDLPop.initialize(false, true);
+  State simState(&simSDLPop, saveString);
+
+  printf("[Jaffar] Running differential load benchmark (%lu iterations)...\n", iterations);
+  benchmarkDifferentialLoad(simSDLPop, simState, saveString, iterations);
+
+  printf("[Jaffar] Running branch expansion benchmark (%lu iterations)...\n", iterations);
+  benchmarkBranchExpansion(benchSDLPop, benchState, saveString, iterations);
+
+  printf("[Jaffar] Running context switching benchmark (%lu iterations)...\n", iterations);
+  benchmarkContexts(simSDLPop, simState, saveString, contextCount, iterations);
+
+  printf("[Jaffar] Running instance construction benchmark...\n");
+  benchmarkConstruction(benchSDLPop, instanceCount);
+
+  printf("[Jaffar] Running segment snapshot benchmark (%lu iterations)...\n", iterations);
+  benchmarkSegmentSnapshot(benchSDLPop, benchState, saveString, iterations);
+
+  printf("[Jaffar] Validating item map against segment snapshots...\n");
+  validateItemMap(benchSDLPop, benchState, saveString);
+
+  printf("[Jaffar] Running batch stepping benchmark (%lu iterations)...\n", iterations);
+  benchmarkBatch(benchSDLPop, benchState, saveString, instanceCount, iterations);
+}
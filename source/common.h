@@ -2,3 +2,4 @@
 
 #define JAFFAR_VERSION "1.2.0"
 #define _FRAME_DATA_SIZE 2714
+#define _STATE_SCHEMA_VERSION 1
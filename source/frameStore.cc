@@ -0,0 +1,174 @@
+#include "frameStore.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+
+// Delta encoding: a sequence of [unchanged byte count][changed byte count][changed bytes XOR keyframe],
+// with both counts stored as variable-length integers. Trailing unchanged bytes are omitted.
+
+static inline void writeVarint(std::vector<uint8_t> &dst, size_t value)
+{
+  while (value >= 0x80)
+  {
+    dst.push_back(uint8_t(value | 0x80));
+    value >>= 7;
+  }
+  dst.push_back(uint8_t(value));
+}
+
+static inline size_t readVarint(const uint8_t *&src)
+{
+  size_t value = 0;
+  int shift = 0;
+  while (*src & 0x80)
+  {
+    value |= size_t(*src++ & 0x7F) << shift;
+    shift += 7;
+  }
+  value |= size_t(*src++) << shift;
+  return value;
+}
+
+FrameStore::FrameStore(const size_t keyframeInterval, const size_t frameSize) : _keyframeArena(frameSize, 64)
+{
+  if (keyframeInterval == 0) EXIT_WITH_ERROR("[Error] Keyframe interval must be at least 1.\n");
+  _keyframeInterval = keyframeInterval;
+  _frameSize = frameSize;
+}
+
+void FrameStore::push(const std::string_view frameData)
+{
+  if (frameData.size() != _frameSize)
+    EXIT_WITH_ERROR("[Error] Wrong frame size. Expected %lu, got: %lu\n", _frameSize, frameData.size());
+
+  const size_t idx = _deltaOffsets.size();
+  _deltaOffsets.push_back(_deltaData.size());
+  _deltaSizes.push_back(0);
+
+  if (idx % _keyframeInterval == 0)
+  {
+    size_t slotId = _keyframeArena.allocate();
+    memcpy(_keyframeArena.getSlot(slotId), frameData.data(), _frameSize);
+    _keyframeSlots.push_back(slotId);
+  }
+  else
+    storeDelta(idx, frameData.data());
+}
+
+void FrameStore::storeDelta(const size_t idx, const char *frameData)
+{
+  const char *keyframe = _keyframeArena.getSlot(_keyframeSlots[idx / _keyframeInterval]);
+  _deltaBuffer.clear();
+
+  size_t pos = 0;
+  while (pos < _frameSize)
+  {
+    // Counting unchanged bytes
+    size_t skip = 0;
+    while (pos + skip < _frameSize && frameData[pos + skip] == keyframe[pos + skip]) skip++;
+    if (pos + skip == _frameSize) break;
+
+    // Counting changed bytes
+    size_t literal = 0;
+    while (pos + skip + literal < _frameSize && frameData[pos + skip + literal] != keyframe[pos + skip + literal]) literal++;
+
+    writeVarint(_deltaBuffer, skip);
+    writeVarint(_deltaBuffer, literal);
+    for (size_t i = pos + skip; i < pos + skip + literal; i++) _deltaBuffer.push_back(uint8_t(frameData[i] ^ keyframe[i]));
+
+    pos += skip + literal;
+  }
+
+  // Edited frames reuse the space of their previous delta whenever the new one fits in it
+  const size_t deltaSize = _deltaBuffer.size();
+  if (deltaSize <= _deltaSizes[idx])
+  {
+    memcpy(_deltaData.data() + _deltaOffsets[idx], _deltaBuffer.data(), deltaSize);
+    _unusedDeltaBytes += _deltaSizes[idx] - deltaSize;
+  }
+  else
+  {
+    _unusedDeltaBytes += _deltaSizes[idx];
+    _deltaOffsets[idx] = _deltaData.size();
+    _deltaData.insert(_deltaData.end(), _deltaBuffer.begin(), _deltaBuffer.end());
+  }
+  _deltaSizes[idx] = deltaSize;
+
+  // Keeping the delta storage within twice the size of the deltas in use
+  if (_unusedDeltaBytes > _deltaData.size() / 2) compactDeltas();
+}
+
+void FrameStore::compactDeltas()
+{
+  std::vector<uint8_t> deltaData;
+  deltaData.reserve(_deltaData.size() - _unusedDeltaBytes);
+
+  for (size_t i = 0; i < size(); i++)
+  {
+    const size_t offset = deltaData.size();
+    deltaData.insert(deltaData.end(), _deltaData.begin() + _deltaOffsets[i], _deltaData.begin() + _deltaOffsets[i] + _deltaSizes[i]);
+    _deltaOffsets[i] = offset;
+  }
+
+  _deltaData.swap(deltaData);
+  _unusedDeltaBytes = 0;
+}
+
+void FrameStore::get(const size_t idx, char *frameData) const
+{
+  if (idx >= size()) EXIT_WITH_ERROR("[Error] Requested frame %lu, but only %lu are stored.\n", idx, size());
+
+  memcpy(frameData, _keyframeArena.getSlot(_keyframeSlots[idx / _keyframeInterval]), _frameSize);
+
+  const uint8_t *src = _deltaData.data() + _deltaOffsets[idx];
+  const uint8_t *end = src + _deltaSizes[idx];
+  size_t pos = 0;
+  while (src < end)
+  {
+    pos += readVarint(src);
+    size_t literal = readVarint(src);
+    for (size_t i = 0; i < literal; i++) frameData[pos + i] ^= src[i];
+    src += literal;
+    pos += literal;
+  }
+}
+
+std::string FrameStore::get(const size_t idx) const
+{
+  std::string frameData;
+  frameData.resize(_frameSize);
+  get(idx, &frameData[0]);
+  return frameData;
+}
+
+void FrameStore::set(const size_t idx, const std::string_view frameData)
+{
+  if (idx >= size()) EXIT_WITH_ERROR("[Error] Requested frame %lu, but only %lu are stored.\n", idx, size());
+  if (frameData.size() != _frameSize)
+    EXIT_WITH_ERROR("[Error] Wrong frame size. Expected %lu, got: %lu\n", _frameSize, frameData.size());
+
+  // Non-keyframes only need their own delta replaced
+  if (idx % _keyframeInterval != 0)
+  {
+    storeDelta(idx, frameData.data());
+    return;
+  }
+
+  // Replacing a keyframe requires re-encoding the rest of its group against it
+  const size_t groupEnd = std::min(idx + _keyframeInterval, size());
+  std::vector<std::string> groupFrames;
+  for (size_t i = idx + 1; i < groupEnd; i++) groupFrames.push_back(get(i));
+
+  memcpy(_keyframeArena.getSlot(_keyframeSlots[idx / _keyframeInterval]), frameData.data(), _frameSize);
+  for (size_t i = idx + 1; i < groupEnd; i++) storeDelta(i, groupFrames[i - idx - 1].data());
+}
+
+size_t FrameStore::getMemoryUsage() const
+{
+  size_t memoryUsage = _keyframeArena.getMemoryUsage();
+  memoryUsage += _keyframeSlots.size() * sizeof(size_t);
+  memoryUsage += _deltaData.capacity() + _deltaBuffer.capacity();
+  memoryUsage += _deltaOffsets.size() * sizeof(size_t);
+  memoryUsage += _deltaSizes.size() * sizeof(size_t);
+  return memoryUsage;
+}
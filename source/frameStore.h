@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common.h"
+#include "stateArena.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Storage for a sequence of frames. A full keyframe is kept every N frames and the frames
+// in between are stored as run-length encoded XOR deltas against their keyframe. This way,
+// accessing any frame only requires a keyframe copy and a single delta application.
+class FrameStore
+{
+  public:
+  FrameStore(const size_t keyframeInterval, const size_t frameSize = _FRAME_DATA_SIZE);
+
+  // Appends a new frame at the end of the sequence
+  void push(const std::string_view frameData);
+
+  // Retrieves the frame data at the given position into a buffer of the frame size
+  void get(const size_t idx, char *frameData) const;
+  std::string get(const size_t idx) const;
+
+  // Replaces the frame data at the given position
+  void set(const size_t idx, const std::string_view frameData);
+
+  // Number of stored frames
+  size_t size() const { return _deltaOffsets.size(); }
+
+  // Bytes used to store the frames
+  size_t getMemoryUsage() const;
+
+  private:
+  size_t _keyframeInterval;
+  size_t _frameSize;
+
+  // Full keyframes, one every _keyframeInterval frames, stored in arena slots
+  StateArena _keyframeArena;
+  std::vector<size_t> _keyframeSlots;
+
+  // Contiguous delta storage and the position/length of each frame's delta within it
+  std::vector<uint8_t> _deltaData;
+  std::vector<size_t> _deltaOffsets;
+  std::vector<size_t> _deltaSizes;
+
+  // Bytes of the delta storage left behind by replaced deltas, and the buffer deltas are encoded into
+  size_t _unusedDeltaBytes = 0;
+  std::vector<uint8_t> _deltaBuffer;
+
+  // Encodes the delta of a frame against its keyframe and stores it for the given position, in place
+  // of its previous delta if it fits
+  void storeDelta(const size_t idx, const char *frameData);
+
+  // Moves all deltas together, dropping the unused bytes between them
+  void compactDeltas();
+};
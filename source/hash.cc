@@ -0,0 +1,141 @@
+#include "hash.h"
+#include <cstring>
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(const uint64_t x, const int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t hashRound(uint64_t acc, const uint64_t input)
+{
+  acc += input * PRIME2;
+  acc = rotl(acc, 31);
+  return acc * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, const uint64_t val)
+{
+  acc ^= hashRound(0, val);
+  return acc * PRIME1 + PRIME4;
+}
+
+// Processes as many full stripes as possible, returns the number of bytes consumed
+static inline size_t processStripes(uint64_t *lanes, const uint8_t *data, const size_t size)
+{
+  size_t pos = 0;
+  for (; pos + 32 <= size; pos += 32)
+    for (int i = 0; i < 4; i++) lanes[i] = hashRound(lanes[i], read64(data + pos + i * 8));
+  return pos;
+}
+
+Hasher::Hasher(const uint64_t seed)
+{
+  _seed = seed;
+  _lanes[0] = seed + PRIME1 + PRIME2;
+  _lanes[1] = seed + PRIME2;
+  _lanes[2] = seed;
+  _lanes[3] = seed - PRIME1;
+  _bufferSize = 0;
+  _totalSize = 0;
+}
+
+void Hasher::update(const void *data, const size_t size)
+{
+  const uint8_t *input = (const uint8_t *)data;
+  size_t remaining = size;
+  _totalSize += size;
+
+  // Filling the pending stripe first
+  if (_bufferSize > 0)
+  {
+    size_t fill = 32 - _bufferSize;
+    if (fill > remaining) fill = remaining;
+    memcpy(_buffer + _bufferSize, input, fill);
+    _bufferSize += fill;
+    input += fill;
+    remaining -= fill;
+
+    if (_bufferSize < 32) return;
+    processStripes(_lanes, _buffer, 32);
+    _bufferSize = 0;
+  }
+
+  // Processing full stripes directly from the input
+  size_t consumed = processStripes(_lanes, input, remaining);
+
+  // Storing the tail for the next update
+  memcpy(_buffer, input + consumed, remaining - consumed);
+  _bufferSize = remaining - consumed;
+}
+
+uint64_t Hasher::digest() const
+{
+  uint64_t h;
+
+  if (_totalSize >= 32)
+  {
+    h = rotl(_lanes[0], 1) + rotl(_lanes[1], 7) + rotl(_lanes[2], 12) + rotl(_lanes[3], 18);
+    for (int i = 0; i < 4; i++) h = mergeRound(h, _lanes[i]);
+  }
+  else
+    h = _seed + PRIME5;
+
+  h += _totalSize;
+
+  // Finalizing with the pending bytes
+  size_t pos = 0;
+  for (; pos + 8 <= _bufferSize; pos += 8)
+  {
+    h ^= hashRound(0, read64(_buffer + pos));
+    h = rotl(h, 27) * PRIME1 + PRIME4;
+  }
+
+  if (pos + 4 <= _bufferSize)
+  {
+    h ^= (uint64_t)read32(_buffer + pos) * PRIME1;
+    h = rotl(h, 23) * PRIME2 + PRIME3;
+    pos += 4;
+  }
+
+  for (; pos < _bufferSize; pos++)
+  {
+    h ^= _buffer[pos] * PRIME5;
+    h = rotl(h, 11) * PRIME1;
+  }
+
+  // Avalanche
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+uint64_t hashBuffer(const void *data, const size_t size, const uint64_t seed)
+{
+  Hasher hasher(seed);
+  hasher.update(data, size);
+  return hasher.digest();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Streaming 64-bit hash (xxHash64 construction). Input is consumed in 32-byte
+// stripes over four independent lanes, so that the compiler can keep them in vector registers.
+class Hasher
+{
+  public:
+  Hasher(const uint64_t seed = 0);
+
+  // Adds a block of memory to the hash
+  void update(const void *data, const size_t size);
+
+  // Adds a single value to the hash
+  template <typename T>
+  void update(const T &value) { update(&value, sizeof(T)); }
+
+  // Produces the hash of all the data added so far
+  uint64_t digest() const;
+
+  private:
+  uint64_t _seed;
+  uint64_t _lanes[4];
+  uint8_t _buffer[32];
+  size_t _bufferSize;
+  uint64_t _totalSize;
+};
+
+// Hashes a single block of memory
+uint64_t hashBuffer(const void *data, const size_t size, const uint64_t seed = 0);
@@ -0,0 +1,195 @@
+#include "move.h"
+#include "utils.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Canonical moves, by their code in binary solution files
+static const Move _canonicalMoves[] = {
+  0,
+  MOVE_SHIFT,
+  MOVE_UP,
+  MOVE_LEFT,
+  MOVE_RIGHT,
+  MOVE_DOWN,
+  MOVE_LEFT | MOVE_UP,
+  MOVE_LEFT | MOVE_DOWN,
+  MOVE_RIGHT | MOVE_UP,
+  MOVE_RIGHT | MOVE_DOWN,
+  MOVE_SHIFT | MOVE_RIGHT,
+  MOVE_SHIFT | MOVE_LEFT,
+  MOVE_SHIFT | MOVE_UP,
+  MOVE_SHIFT | MOVE_DOWN,
+  MOVE_RESTART};
+
+Move parseMove(const std::string &move)
+{
+  // Ctrl+A restarts the level and holds no keys
+  if (move == "CA") return MOVE_RESTART;
+
+  Move result = 0;
+  bool recognizedMove = false;
+
+  for (const char c : move)
+  {
+    if (c == '.') recognizedMove = true;
+    if (c == 'U') result |= MOVE_UP;
+    if (c == 'D') result |= MOVE_DOWN;
+    if (c == 'L') result |= MOVE_LEFT;
+    if (c == 'R') result |= MOVE_RIGHT;
+    if (c == 'S') result |= MOVE_SHIFT;
+  }
+
+  if (recognizedMove == false && result == 0) EXIT_WITH_ERROR("[Error] Unrecognized move: %s\n", move.c_str());
+  return result;
+}
+
+std::string moveToString(const Move move)
+{
+  if (move & MOVE_RESTART) return "CA";
+
+  std::string result;
+  if (move & MOVE_SHIFT) result += 'S';
+  if (move & MOVE_LEFT) result += 'L';
+  if (move & MOVE_RIGHT) result += 'R';
+  if (move & MOVE_UP) result += 'U';
+  if (move & MOVE_DOWN) result += 'D';
+  if (result.empty()) result = ".";
+  return result;
+}
+
+std::vector<Move> parseMoveSequence(const std::string &moveSequence)
+{
+  std::vector<Move> moves;
+  for (const auto &move : split(moveSequence, ' '))
+    if (move.empty() == false) moves.push_back(parseMove(move));
+  return moves;
+}
+
+bool isSolutionFile(const char *fileName)
+{
+  FILE *fid = fopen(fileName, "rb");
+  if (fid == NULL) return false;
+
+  char magic[8];
+  bool isBinary = fread(magic, 1, sizeof(magic), fid) == sizeof(magic) && memcmp(magic, _SOLUTION_FILE_MAGIC, sizeof(magic)) == 0;
+  fclose(fid);
+  return isBinary;
+}
+
+bool saveSolutionFile(const std::vector<Move> &moves, const char *fileName)
+{
+  // Code of every move value, escaping those outside the canonical set
+  uint8_t moveCodes[_MOVE_COUNT];
+  memset(moveCodes, _SOLUTION_FILE_ESCAPE_CODE, sizeof(moveCodes));
+  for (uint8_t code = 0; code < sizeof(_canonicalMoves); code++) moveCodes[_canonicalMoves[code]] = code;
+
+  std::vector<uint8_t> nibbles;
+  nibbles.reserve(moves.size());
+  for (const auto move : moves)
+  {
+    if (move >= _MOVE_COUNT) EXIT_WITH_ERROR("[Error] Invalid move value: %u\n", move);
+    nibbles.push_back(moveCodes[move]);
+    if (moveCodes[move] == _SOLUTION_FILE_ESCAPE_CODE)
+    {
+      nibbles.push_back(move & 0xF);
+      nibbles.push_back(move >> 4);
+    }
+  }
+
+  std::string fileData(sizeof(SolutionFileHeader) + (nibbles.size() + 1) / 2, '\0');
+
+  SolutionFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, _SOLUTION_FILE_MAGIC, sizeof(header.magic));
+  header.formatVersion = _SOLUTION_FILE_FORMAT_VERSION;
+  header.moveCount = moves.size();
+  memcpy(&fileData[0], &header, sizeof(header));
+
+  uint8_t *packedData = (uint8_t *)&fileData[sizeof(header)];
+  for (size_t i = 0; i < nibbles.size(); i++) packedData[i / 2] |= nibbles[i] << (4 * (i % 2));
+
+  return saveStringToFile(fileData, fileName);
+}
+
+SolutionFileReader::SolutionFileReader(const char *fileName)
+{
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0) EXIT_WITH_ERROR("[Error] Could not open solution file: %s\n", fileName);
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(SolutionFileHeader)) EXIT_WITH_ERROR("[Error] Solution file is too small: %s\n", fileName);
+  _mappedSize = fileStat.st_size;
+
+  void *mappedData = mmap(NULL, _mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mappedData == MAP_FAILED) EXIT_WITH_ERROR("[Error] Could not map solution file: %s\n", fileName);
+
+  memcpy(&_header, mappedData, sizeof(_header));
+  _nibbleCount = (_mappedSize - sizeof(SolutionFileHeader)) * 2;
+
+  // Every move takes at least one nibble, so a larger move count can only come from a corrupted header
+  const bool isValidMagic = memcmp(_header.magic, _SOLUTION_FILE_MAGIC, sizeof(_header.magic)) == 0;
+  const bool isValidVersion = _header.formatVersion == _SOLUTION_FILE_FORMAT_VERSION;
+  const bool isValidMoveCount = _header.moveCount <= _nibbleCount;
+  if (isValidMagic == false || isValidVersion == false || isValidMoveCount == false) munmap(mappedData, _mappedSize);
+  if (isValidMagic == false) EXIT_WITH_ERROR("[Error] Not a binary solution file: %s\n", fileName);
+  if (isValidVersion == false) EXIT_WITH_ERROR("[Error] Unsupported solution file format version %u (expected %u): %s\n", _header.formatVersion, _SOLUTION_FILE_FORMAT_VERSION, fileName);
+  if (isValidMoveCount == false) EXIT_WITH_ERROR("[Error] Solution file declares %lu moves, more than it can hold: %s\n", _header.moveCount, fileName);
+
+  // Moves are read in sequence, so the kernel can read ahead
+  madvise(mappedData, _mappedSize, MADV_SEQUENTIAL);
+
+  _data = (const uint8_t *)mappedData + sizeof(SolutionFileHeader);
+  _nibblePos = 0;
+  _movePos = 0;
+}
+
+SolutionFileReader::~SolutionFileReader()
+{
+  munmap((void *)(_data - sizeof(SolutionFileHeader)), _mappedSize);
+}
+
+uint8_t SolutionFileReader::readNibble()
+{
+  if (_nibblePos >= _nibbleCount) EXIT_WITH_ERROR("[Error] Solution file is truncated after %lu moves.\n", _movePos);
+  const uint8_t nibble = (_data[_nibblePos / 2] >> (4 * (_nibblePos % 2))) & 0xF;
+  _nibblePos++;
+  return nibble;
+}
+
+bool SolutionFileReader::next(Move &move)
+{
+  if (_movePos >= _header.moveCount) return false;
+
+  const uint8_t code = readNibble();
+  if (code != _SOLUTION_FILE_ESCAPE_CODE) move = _canonicalMoves[code];
+  if (code == _SOLUTION_FILE_ESCAPE_CODE)
+  {
+    move = readNibble();
+    move |= readNibble() << 4;
+  }
+
+  _movePos++;
+  return true;
+}
+
+bool loadSolutionFile(std::vector<Move> &moves, const char *fileName)
+{
+  moves.clear();
+
+  if (isSolutionFile(fileName))
+  {
+    SolutionFileReader reader(fileName);
+    moves.resize(reader.size());
+    for (size_t i = 0; i < moves.size(); i++) reader.next(moves[i]);
+    return true;
+  }
+
+  std::string moveSequence;
+  if (loadStringFromFile(moveSequence, fileName) == false) return false;
+  moves = parseMoveSequence(moveSequence);
+  return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A move packed into a single byte: one bit per key held, plus the level restart (Ctrl+A) command
+typedef uint8_t Move;
+
+enum moveBit : Move
+{
+  MOVE_UP = 1 << 0,
+  MOVE_DOWN = 1 << 1,
+  MOVE_LEFT = 1 << 2,
+  MOVE_RIGHT = 1 << 3,
+  MOVE_SHIFT = 1 << 4,
+  MOVE_RESTART = 1 << 5
+};
+
+// Number of distinct move values
+#define _MOVE_COUNT 64
+
+// Parses a move in solution file notation (e.g., ".", "LU", "SR", "CA")
+Move parseMove(const std::string &move);
+
+// Produces the solution file notation for a move
+std::string moveToString(const Move move);
+
+// Parses the contents of a solution file into a packed move array
+std::vector<Move> parseMoveSequence(const std::string &moveSequence);
+
+// Binary solution files (.solb): a header followed by the moves packed in 4 bits each (low nibble first).
+// Codes 0 to 14 stand for the canonical moves below. Code 15 escapes any other move, which follows
+// as two more nibbles holding its value.
+#define _SOLUTION_FILE_MAGIC "JAFFARSB"
+#define _SOLUTION_FILE_FORMAT_VERSION 1
+#define _SOLUTION_FILE_ESCAPE_CODE 15
+
+struct SolutionFileHeader
+{
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t reserved;
+  uint64_t moveCount;
+};
+
+// Checks whether the given file is a binary solution file
+bool isSolutionFile(const char *fileName);
+
+// Writes a binary solution file
+bool saveSolutionFile(const std::vector<Move> &moves, const char *fileName);
+
+// Maps a binary solution file into memory and decodes its moves as they are requested
+class SolutionFileReader
+{
+  public:
+  SolutionFileReader(const char *fileName);
+  ~SolutionFileReader();
+
+  // Total number of moves in the file
+  size_t size() const { return _header.moveCount; }
+
+  // Decodes the next move. Returns false once all the moves have been read
+  bool next(Move &move);
+
+  private:
+  SolutionFileHeader _header;
+  const uint8_t *_data;
+  size_t _mappedSize;
+  size_t _nibbleCount;
+  size_t _nibblePos;
+  size_t _movePos;
+
+  uint8_t readNibble();
+};
+
+// Loads a solution file, either binary (.solb) or text (.sol), decoding all of its moves into the given array
+bool loadSolutionFile(std::vector<Move> &moves, const char *fileName);
@@ -1,7 +1,12 @@
 #include "argparse.hpp"
 #include "common.h"
+#include "frameStore.h"
+#include "segmentSnapshot.h"
+#include "stateArena.h"
 #include "state.h"
 #include "utils.h"
+#include <chrono>
+#include <memory>
 #include <ncurses.h>
 #include <unistd.h>
 
@@ -51,7 +56,7 @@ int main(int argc, char *argv[])
     .required();
 
   program.add_argument("solutionFile")
-    .help("path to the Jaffar solution (.sol) file to run.")
+    .help("path to the Jaffar solution (.sol or .solb) file to run.")
     .required();
 
   program.add_argument("--reproduce")
@@ -59,6 +64,19 @@ int main(int argc, char *argv[])
     .default_value(false)
     .implicit_value(true);
 
+  program.add_argument("--stateIndex")
+    .help("If the savefile is a state container, index of the state to start from. Negative values count from the end.")
+    .default_value(std::string("-1"));
+
+  program.add_argument("--exactRewind")
+    .help("Restores whole-segment snapshots of the SDLPop memory when moving between steps, instead of the state items. Uses more memory.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--keyframeInterval")
+    .help("Number of steps between full frames stored in memory. Steps in between are stored as deltas.")
+    .default_value(std::string("64"));
+
   // Parsing command line
   try
   {
@@ -73,18 +91,22 @@ int main(int argc, char *argv[])
   // Getting reproduce path
   bool isReproduce = program.get<bool>("--reproduce");
 
+  // Getting exact rewind flag
+  bool isExactRewind = program.get<bool>("--exactRewind");
+
+  // Getting state index for state containers
+  const long stateIndex = std::stol(program.get<std::string>("--stateIndex"));
+
+  // Getting keyframe interval
+  const size_t keyframeInterval = std::stoul(program.get<std::string>("--keyframeInterval"));
+
   // Getting savefile path
   std::string saveFilePath = program.get<std::string>("savFile");
 
-  // Loading save file contents
-  std::string saveString;
-  bool status = loadStringFromFile(saveString, saveFilePath.c_str());
-  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not load save state from file: %s\n", saveFilePath.c_str());
-
   // If sequence file defined, load it and play it
-  std::string moveSequence;
+  std::vector<Move> moveList;
   std::string solutionFile = program.get<std::string>("solutionFile");
-  status = loadStringFromFile(moveSequence, solutionFile.c_str());
+  bool status = loadSolutionFile(moveList, solutionFile.c_str());
   if (status == false) EXIT_WITH_ERROR("[ERROR] Could not find or read from solution file: %s\n%s \n", solutionFile.c_str(), program.help().str().c_str());
 
   // Initializing ncurses screen
@@ -94,15 +116,13 @@ int main(int argc, char *argv[])
   nodelay(stdscr, TRUE);
   scrollok(stdscr, TRUE);
 
-  // Getting move list
-  const auto moveList = split(moveSequence, ' ');
-
-  // Getting sequence size
-  const int sequenceLength = moveList.size()-1;
+  // Getting sequence size, counting the initial frame plus one frame per move
+  const int moveCount = moveList.size();
+  const int sequenceLength = moveCount+1;
 
   // Printing info
   printw("[Jaffar] Playing sequence file: %s\n", solutionFile.c_str());
-  printw("[Jaffar] Sequence Size: %d moves.\n", sequenceLength-1);
+  printw("[Jaffar] Sequence Size: %d moves.\n", moveCount);
   printw("[Jaffar] Generating frame sequence...\n");
 
   refresh();
@@ -111,8 +131,20 @@ int main(int argc, char *argv[])
   SDLPopInstance genSDLPop("libsdlPopLib.so", false);
   genSDLPop.initialize(false);
 
+  // Loading save file contents
+  std::string saveString;
+  status = State::loadFrameFromFile(genSDLPop, saveFilePath.c_str(), stateIndex, saveString);
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not load save state from file: %s\n", saveFilePath.c_str());
+
   // Storage for sequence frames
-  std::vector<std::string> frameSequence;
+  FrameStore frameSequence(keyframeInterval);
+
+  // Working slots for the frame being generated and the frame currently in view
+  StateArena frameArena(_FRAME_DATA_SIZE, 2);
+  char *genFrame = frameArena.getSlot(frameArena.allocate());
+  char *currentFrame = frameArena.getSlot(frameArena.allocate());
+  const std::string_view genFrameView(genFrame, _FRAME_DATA_SIZE);
+  const std::string_view currentFrameView(currentFrame, _FRAME_DATA_SIZE);
 
   // Starting replay creation
   genSDLPop.init_record_replay();
@@ -121,18 +153,33 @@ int main(int argc, char *argv[])
   // Initializing generating State Handler
   State genState(&genSDLPop, saveString);
 
-  // Saving initial frame
-  frameSequence.push_back(genState.saveState());
-
-  // Iterating move list in the sequence
-  for (int i = 0; i < sequenceLength-1; i++)
-  {
-    genSDLPop.performMove(moveList[i]);
-    genSDLPop.advanceFrame();
+  // Remembering the starting level number
+  const word startLevelId = *genSDLPop.current_level;
 
-    // Storing new frame
-    frameSequence.push_back(genState.saveState());
-  }
+  // Saving initial frame
+  genState.saveState(genFrame);
+  frameSequence.push(genFrameView);
+
+  // Iterating move list in the sequence, storing every new frame
+  genSDLPop.advanceFrames(moveList.data(), moveList.size(), 1, [&](const size_t) {
+    genState.saveState(genFrame);
+    frameSequence.push(genFrameView);
+    return true;
+  });
+
+  // Reporting frame storage memory use
+  const double storedMB = (double)frameSequence.getMemoryUsage() / (1024.0 * 1024.0);
+  const double rawMB = (double)(frameSequence.size() * _FRAME_DATA_SIZE) / (1024.0 * 1024.0);
+  printw("[Jaffar] Frame storage: %.3f MB (%.3f MB uncompressed, keyframe every %lu steps)\n", storedMB, rawMB, keyframeInterval);
+
+  // Measuring average seek latency over the whole sequence
+  const size_t seekStride = frameSequence.size() / 1000 + 1;
+  size_t seekCount = 0;
+  auto seekT0 = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < frameSequence.size(); i += seekStride, seekCount++) frameSequence.get(i, genFrame);
+  auto seekTf = std::chrono::high_resolution_clock::now();
+  double seekLatency = std::chrono::duration_cast<std::chrono::nanoseconds>(seekTf - seekT0).count() * 1.0e-3 / (double)seekCount;
+  printw("[Jaffar] Average seek latency: %.3f us\n", seekLatency);
 
 //  saveStringToFile(sequenceJs.dump(2).c_str(), "sequence.js");
   printw("[Jaffar] Opening SDLPop window...\n");
@@ -141,8 +188,34 @@ int main(int argc, char *argv[])
   SDLPopInstance showSDLPop("libsdlPopLib.so", false);
   showSDLPop.initialize(true);
 
-  // Initializing State Handler
+  // Initializing State Handler. Scrubbing between nearby steps only needs to restore what changed
   State showState(&showSDLPop, saveString);
+  showState.setDifferentialLoad(true);
+
+  // For exact rewinds, the sequence is run again on the showing instance, storing snapshots of its whole memory
+  std::unique_ptr<SegmentSnapshot> showSnapshot;
+  std::unique_ptr<FrameStore> snapshotSequence;
+  std::string snapshotFrame;
+  if (isExactRewind)
+  {
+    showSnapshot.reset(new SegmentSnapshot(&showSDLPop));
+    snapshotSequence.reset(new FrameStore(keyframeInterval, showSnapshot->getSize()));
+    snapshotFrame.resize(showSnapshot->getSize());
+
+    frameSequence.get(0, currentFrame);
+    showState.loadState(currentFrameView);
+    showSnapshot->save(&snapshotFrame[0]);
+    snapshotSequence->push(snapshotFrame);
+
+    showSDLPop.advanceFrames(moveList.data(), moveList.size(), 1, [&](const size_t) {
+      showSnapshot->save(&snapshotFrame[0]);
+      snapshotSequence->push(snapshotFrame);
+      return true;
+    });
+
+    const double snapshotMB = (double)snapshotSequence->getMemoryUsage() / (1024.0 * 1024.0);
+    printw("[Jaffar] Segment snapshot storage: %.3f MB (%lu bytes per snapshot)\n", snapshotMB, showSnapshot->getSize());
+  }
 
   // Setting window title
   SDL_SetWindowTitle(*showSDLPop.window_, "Jaffar Play");
@@ -153,12 +226,19 @@ int main(int argc, char *argv[])
   // Variable for current step in view
   int currentStep = 0;
 
+  // Replaces the stored frame for the current step with the contents of the showing instance
+  auto storeCurrentStep = [&]() {
+    showState.saveState(currentFrame);
+    frameSequence.set(currentStep, currentFrameView);
+    if (isExactRewind) snapshotSequence->set(currentStep, showSnapshot->save());
+  };
+
   // Print command list
   if (isReproduce == false)
   {
    printw("[Jaffar] Available commands:\n");
    printw("[Jaffar]  n: -1 m: +1 | h: -10 | j: +10 | y: -100 | u: +100 \n");
-   printw("[Jaffar]  g: set RNG | l: loose tile sound | s: quicksave | r: create replay | q: quit  \n");
+   printw("[Jaffar]  g: set RNG | l: loose tile sound | s: quicksave | a: save all states | r: create replay | q: quit  \n");
    printw("[Jaffar]  1: set lvl1 music | w: set current hp | e: set max hp \n");
   }
 
@@ -170,7 +250,13 @@ int main(int argc, char *argv[])
   do
   {
     // Loading requested step
-    showState.loadState(frameSequence[currentStep]);
+    frameSequence.get(currentStep, currentFrame);
+    if (isExactRewind == false) showState.loadState(currentFrameView);
+    if (isExactRewind == true)
+    {
+      snapshotSequence->get(currentStep, &snapshotFrame[0]);
+      showSnapshot->load(snapshotFrame.data());
+    }
 
     // Calculating timing
     size_t curMins = currentStep / 720;
@@ -180,7 +266,9 @@ int main(int argc, char *argv[])
     showSDLPop._IGTMins = curMins;
     showSDLPop._IGTSecs = curSecs;
     showSDLPop._IGTMillisecs = curMilliSecs;
-    showSDLPop._move = moveList[currentStep];
+    // The last frame has no move left to perform
+    const std::string currentMove = currentStep < moveCount ? moveToString(moveList[currentStep]) : ".";
+    showSDLPop._move = currentMove;
 
     size_t sequenceStep = sequenceLength-1;
     size_t maxMins = sequenceStep / 720;
@@ -195,7 +283,7 @@ int main(int argc, char *argv[])
       printw("[Jaffar] ----------------------------------------------------------------\n");
       printw("[Jaffar] Current Step #: %d / %d\n", currentStep, sequenceLength-1);
       printw("[Jaffar]  + Current IGT:    %2lu:%02lu.%03lu / %2lu:%02lu.%03lu\n", curMins, curSecs, curMilliSecs, maxMins, maxSecs, maxMilliSecs);
-      printw("[Jaffar]  + Move: %s\n", moveList[currentStep].c_str());
+      printw("[Jaffar]  + Move: %s\n", currentMove.c_str());
 
       printw("[Jaffar]  + [Kid]   Room: %d, Pos.x: %3d, Pos.y: %3d, Row: %2d, Col: %2d, Fall.y: %d, Frame: %3d, HP: %d/%d, Dir: %d, SeqId: %d\n",
              int(showSDLPop.Kid->room),
@@ -230,7 +318,8 @@ int main(int argc, char *argv[])
       printw("[Jaffar]  + Is Guard Notice: %d\n", *showSDLPop.is_guard_notice);
       printw("[Jaffar]  + Guard Refrac: %d\n", *showSDLPop.guard_refrac);
       printw("[Jaffar]  + Guard Notice Timer: %d\n", *showSDLPop.guard_notice_timer);
-      printw("[Jaffar]  + Exit Door Open: %s (%d)\n", showSDLPop.isLevelExitDoorOpen() ? "Yes" : "No", *showSDLPop.leveldoor_open);
+      printw("[Jaffar]  + Exit Door Open: %s (%d)\n", showSDLPop.getLevelFeatures().isExitDoorOpen ? "Yes" : "No", *showSDLPop.leveldoor_open);
+      printw("[Jaffar]  + Loose Tiles Left: %lu\n", showSDLPop.getLevelFeatures().looseTiles.size());
       printw("[Jaffar]  + Reached Checkpoint: %s (%d)\n", *showSDLPop.checkpoint ? "Yes" : "No", *showSDLPop.checkpoint);
       printw("[Jaffar]  + Feather Fall: %d\n", *showSDLPop.is_feather_fall);
       printw("[Jaffar]  + Need Lvl1 Music: %d\n", *showSDLPop.need_level1_music);
@@ -366,7 +455,7 @@ int main(int argc, char *argv[])
       std::string saveFileName = "jaffar.sav";
 
       // Saving frame info to file
-      bool status = saveStringToFile(frameSequence[currentStep], saveFileName.c_str());
+      bool status = saveStringToFile(currentFrameView, saveFileName.c_str());
       if (status == true) printw("[Jaffar] State saved in '%s'.\n", saveFileName.c_str());
       if (status == false) printw("[Jaffar] Error saving file '%s'.\n", saveFileName.c_str());
 
@@ -374,6 +463,25 @@ int main(int argc, char *argv[])
       showFrameInfo = false;
     }
 
+    // State container creation command
+    if (command == 'a')
+    {
+      std::string stateFileName = "jaffar.savs";
+
+      // Storing every step of the sequence
+      StateFileWriter writer(stateFileName.c_str(), _STATE_SCHEMA_VERSION, State::getLayoutHash(), startLevelId, State::getMaxCompactStateSize());
+      for (size_t i = 0; i < frameSequence.size(); i++)
+      {
+        frameSequence.get(i, genFrame);
+        genState.addToStateFile(writer, genFrame);
+      }
+      writer.close();
+      printw("[Jaffar] %lu states saved in '%s'.\n", writer.size(), stateFileName.c_str());
+
+      // Do no show frame info again after this action
+      showFrameInfo = false;
+    }
+
     // RNG setting command
     if (command == 'g')
     {
@@ -386,7 +494,7 @@ int main(int argc, char *argv[])
       *showSDLPop.random_seed = std::stol(str);
 
       // Replacing current sequence
-      frameSequence[currentStep] = showState.saveState();
+      storeCurrentStep();
     }
 
     // Set current HP
@@ -401,7 +509,7 @@ int main(int argc, char *argv[])
       *showSDLPop.hitp_curr = std::stol(str);
 
       // Replacing current sequence
-      frameSequence[currentStep] = showState.saveState();
+      storeCurrentStep();
     }
 
     // Set max HP
@@ -416,7 +524,7 @@ int main(int argc, char *argv[])
       *showSDLPop.hitp_max = std::stol(str);
 
       // Replacing current sequence
-      frameSequence[currentStep] = showState.saveState();
+      storeCurrentStep();
     }
 
     // loose tile sound setting command
@@ -431,7 +539,7 @@ int main(int argc, char *argv[])
       *showSDLPop.last_loose_sound = std::stoi(str);
 
       // Replacing current sequence
-      frameSequence[currentStep] = showState.saveState();
+      storeCurrentStep();
     }
 
     // loose tile sound setting command
@@ -446,7 +554,7 @@ int main(int argc, char *argv[])
       *showSDLPop.need_level1_music = std::stoi(str);
 
       // Replacing current sequence
-      frameSequence[currentStep] = showState.saveState();
+      storeCurrentStep();
     }
 
   } while (command != 'q');
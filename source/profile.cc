@@ -0,0 +1,216 @@
+#include "argparse.hpp"
+#include "common.h"
+#include "stateArena.h"
+#include "state.h"
+#include "utils.h"
+#include <cmath>
+#include <cstring>
+
+// Change statistics for a single state item
+struct itemProfile_t
+{
+  size_t changeFrames;
+  size_t bytesChanged;
+  double meanByteEntropy;
+  double maxByteEntropy;
+};
+
+// A run of frames over which a character stays in the same sequence
+struct sequenceRun_t
+{
+  size_t startFrame;
+  size_t frameCount;
+  int sequenceId;
+};
+
+// Extends the last run of a sequence timeline with a new frame
+void addToTimeline(std::vector<sequenceRun_t> &timeline, const size_t frame, const int sequenceId)
+{
+  if (timeline.empty() == false && timeline.back().sequenceId == sequenceId)
+    timeline.back().frameCount++;
+  else
+    timeline.push_back({frame, 1, sequenceId});
+}
+
+// Shannon entropy (in bits) of a byte value histogram
+double getEntropy(const uint32_t *histogram, const size_t sampleCount)
+{
+  double entropy = 0.0;
+  for (size_t v = 0; v < 256; v++)
+    if (histogram[v] > 0)
+    {
+      double p = (double)histogram[v] / (double)sampleCount;
+      entropy -= p * std::log2(p);
+    }
+  return entropy;
+}
+
+int main(int argc, char *argv[])
+{
+  // Defining arguments
+  argparse::ArgumentParser program("jaffar-profile", JAFFAR_VERSION);
+
+  program.add_argument("savFile")
+    .help("Specifies the path to the SDLPop savefile (.sav) from which to start.")
+    .required();
+
+  program.add_argument("solutionFile")
+    .help("path to the Jaffar solution (.sol or .solb) file to run.")
+    .required();
+
+  program.add_argument("--output")
+    .help("Path to the report file to produce.")
+    .default_value(std::string("profile.csv"));
+
+  program.add_argument("--format")
+    .help("Report format: csv or json.")
+    .default_value(std::string("csv"));
+
+  program.add_argument("--timeline")
+    .help("Also writes the run-length timeline of kid and guard sequences (CSV) to the given file.")
+    .default_value(std::string(""));
+
+  // Parsing command line
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    fprintf(stderr, "[Jaffar] Error parsing command line arguments: %s\n%s", err.what(), program.help().str().c_str());
+    exit(-1);
+  }
+
+  // Getting arguments
+  std::string saveFilePath = program.get<std::string>("savFile");
+  std::string solutionFile = program.get<std::string>("solutionFile");
+  std::string outputFile = program.get<std::string>("--output");
+  std::string format = program.get<std::string>("--format");
+  if (format != "csv" && format != "json") EXIT_WITH_ERROR("[ERROR] Unknown report format: %s\n", format.c_str());
+  std::string timelineFile = program.get<std::string>("--timeline");
+
+  // Loading solution file
+  std::vector<Move> moveList;
+  bool status = loadSolutionFile(moveList, solutionFile.c_str());
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not find or read from solution file: %s\n", solutionFile.c_str());
+
+  // Initializing profiling SDLPop Instance
+  SDLPopInstance profSDLPop("libsdlPopLib.so", false);
+  profSDLPop.initialize(false);
+
+  // Loading save file contents
+  std::string saveString;
+  status = State::loadFrameFromFile(profSDLPop, saveFilePath.c_str(), 0, saveString);
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not load save state from file: %s\n", saveFilePath.c_str());
+
+  // Initializing State Handler
+  State profState(&profSDLPop, saveString);
+  const auto &items = profState.getItems();
+
+  // Per-item change counters and per-byte value histograms
+  std::vector<itemProfile_t> profiles(items.size(), {0, 0, 0.0, 0.0});
+  std::vector<uint32_t> histograms(_FRAME_DATA_SIZE * 256, 0);
+
+  // Previous and current frames, in arena slots that swap roles after every frame
+  StateArena frameArena(_FRAME_DATA_SIZE, 2);
+  char *prevFrame = frameArena.getSlot(frameArena.allocate());
+  char *curFrame = frameArena.getSlot(frameArena.allocate());
+  profState.saveState(curFrame);
+  memcpy(prevFrame, curFrame, _FRAME_DATA_SIZE);
+  for (size_t pos = 0; pos < _FRAME_DATA_SIZE; pos++) histograms[pos * 256 + (uint8_t)curFrame[pos]]++;
+
+  // Kid and guard sequence timelines, starting from the initial frame
+  std::vector<sequenceRun_t> kidTimeline;
+  std::vector<sequenceRun_t> guardTimeline;
+  addToTimeline(kidTimeline, 0, profSDLPop.getKidSequenceId());
+  addToTimeline(guardTimeline, 0, profSDLPop.getGuardSequenceId());
+
+  printf("[Jaffar] Profiling %lu state items over %lu moves...\n", items.size(), moveList.size());
+
+  profSDLPop.advanceFrames(moveList.data(), moveList.size(), 1, [&](const size_t moveId) {
+    profState.saveState(curFrame);
+    addToTimeline(kidTimeline, moveId + 1, profSDLPop.getKidSequenceId());
+    addToTimeline(guardTimeline, moveId + 1, profSDLPop.getGuardSequenceId());
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+      size_t changedBytes = 0;
+      for (size_t pos = items[i].offset; pos < items[i].offset + items[i].size; pos++)
+      {
+        changedBytes += curFrame[pos] != prevFrame[pos];
+        histograms[pos * 256 + (uint8_t)curFrame[pos]]++;
+      }
+
+      if (changedBytes > 0) profiles[i].changeFrames++;
+      profiles[i].bytesChanged += changedBytes;
+    }
+
+    std::swap(prevFrame, curFrame);
+    return true;
+  });
+
+  // Computing per-byte entropies over all the frames observed
+  const size_t sampleCount = moveList.size() + 1;
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    for (size_t pos = items[i].offset; pos < items[i].offset + items[i].size; pos++)
+    {
+      double entropy = getEntropy(&histograms[pos * 256], sampleCount);
+      profiles[i].meanByteEntropy += entropy;
+      profiles[i].maxByteEntropy = std::max(profiles[i].maxByteEntropy, entropy);
+    }
+    profiles[i].meanByteEntropy /= (double)items[i].size;
+  }
+
+  // Producing report
+  const char *typeNames[] = {"PER_FRAME_STATE", "HASHABLE", "HASHABLE_MANUAL"};
+  const double frameCount = moveList.empty() ? 1.0 : (double)moveList.size();
+  std::string report;
+  char line[1024];
+
+  if (format == "csv") report += "item,type,offset,size,changeFrames,changeFrequency,bytesChanged,avgBytesPerChange,meanByteEntropy,maxByteEntropy\n";
+  if (format == "json") report += "{\n  \"frames\": " + std::to_string(moveList.size()) + ",\n  \"items\": [\n";
+
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    const auto &item = items[i];
+    const auto &profile = profiles[i];
+    double changeFrequency = (double)profile.changeFrames / frameCount;
+    double avgBytesPerChange = profile.changeFrames > 0 ? (double)profile.bytesChanged / (double)profile.changeFrames : 0.0;
+
+    if (format == "csv")
+      snprintf(line, sizeof(line), "%s,%s,%lu,%lu,%lu,%.6f,%lu,%.3f,%.4f,%.4f\n",
+               item.name, typeNames[item.type], item.offset, item.size, profile.changeFrames, changeFrequency, profile.bytesChanged, avgBytesPerChange, profile.meanByteEntropy, profile.maxByteEntropy);
+
+    if (format == "json")
+      snprintf(line, sizeof(line), "    { \"item\": \"%s\", \"type\": \"%s\", \"offset\": %lu, \"size\": %lu, \"changeFrames\": %lu, \"changeFrequency\": %.6f, \"bytesChanged\": %lu, \"avgBytesPerChange\": %.3f, \"meanByteEntropy\": %.4f, \"maxByteEntropy\": %.4f }%s\n",
+               item.name, typeNames[item.type], item.offset, item.size, profile.changeFrames, changeFrequency, profile.bytesChanged, avgBytesPerChange, profile.meanByteEntropy, profile.maxByteEntropy, i + 1 < items.size() ? "," : "");
+
+    report += line;
+  }
+
+  if (format == "json") report += "  ]\n}\n";
+
+  status = saveStringToFile(report, outputFile.c_str());
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not write report file: %s\n", outputFile.c_str());
+  printf("[Jaffar] Item profile saved in '%s'.\n", outputFile.c_str());
+
+  if (timelineFile.empty()) return 0;
+
+  // Producing sequence timeline
+  std::string timeline = "character,startFrame,frameCount,sequenceId,sequence\n";
+  for (const auto &run : kidTimeline)
+  {
+    snprintf(line, sizeof(line), "kid,%lu,%lu,%d,%s\n", run.startFrame, run.frameCount, run.sequenceId, seqNames[run.sequenceId]);
+    timeline += line;
+  }
+  for (const auto &run : guardTimeline)
+  {
+    snprintf(line, sizeof(line), "guard,%lu,%lu,%d,%s\n", run.startFrame, run.frameCount, run.sequenceId, seqNames[run.sequenceId]);
+    timeline += line;
+  }
+
+  status = saveStringToFile(timeline, timelineFile.c_str());
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not write timeline file: %s\n", timelineFile.c_str());
+  printf("[Jaffar] Sequence timeline (%lu kid runs, %lu guard runs) saved in '%s'.\n", kidTimeline.size(), guardTimeline.size(), timelineFile.c_str());
+}
@@ -1,8 +1,7 @@
 #include "argparse.hpp"
 #include "common.h"
-#include "state.h"
+#include "SDLPopInstance.h"
 #include "utils.h"
-#include <unistd.h>
 
 int main(int argc, char *argv[])
 {
@@ -21,6 +20,10 @@ int main(int argc, char *argv[])
     .help("Specifies the new target RNG to backtrace.")
     .required();
 
+  program.add_argument("--printCount")
+    .help("Only prints this many of the last reversed RNG states (0 prints them all).")
+    .default_value(std::string("0"));
+
   try
   {
     program.parse_args(argc, argv);
@@ -39,17 +42,19 @@ int main(int argc, char *argv[])
   const dword targetRNG = std::stol(targetRNGString);
   const dword newTargetRNG = std::stol(newTargetRNGString);
 
-  // Initializing replay generating SDLPop Instance
-  SDLPopInstance RNGPop("libsdlPopLib.so", false);
+  const size_t printCount = std::stoul(program.get<std::string>("--printCount"));
 
-  dword nextRNG = initialRNG;
-  size_t advanceCounter = 0;
-  while (nextRNG != targetRNG) { nextRNG = RNGPop.advanceRNGState(nextRNG); advanceCounter++; }
+  // Solving for the number of advances directly, instead of stepping the RNG until the target comes up
+  const dword advanceCounter = SDLPopInstance::getRNGDistance(initialRNG, targetRNG);
+  const dword nextRNG = SDLPopInstance::advanceRNGState(initialRNG, advanceCounter);
 
-  dword newInitialRNG = newTargetRNG;
-  for (size_t i = 0; i < advanceCounter+10; i++) { printf("0x%X%s\n", newInitialRNG, i == advanceCounter ? "*" : ""); newInitialRNG = RNGPop.reverseRNGState(newInitialRNG); }
+  // Printing the reversed states from the new target, jumping straight to the first one requested
+  const uint64_t printEnd = (uint64_t)advanceCounter + 10;
+  const uint64_t printStart = printCount > 0 && printEnd > printCount ? printEnd - printCount : 0;
+  dword newInitialRNG = SDLPopInstance::reverseRNGState(newTargetRNG, printStart);
+  for (uint64_t i = printStart; i < printEnd; i++) { printf("0x%X%s\n", newInitialRNG, i == advanceCounter ? "*" : ""); newInitialRNG = SDLPopInstance::reverseRNGState(newInitialRNG); }
 
   printf("0x%X, 0x%X, 0x%X\n", initialRNG, nextRNG, targetRNG);
-  printf("Advances: %lu\n", advanceCounter);
+  printf("Advances: %u\n", advanceCounter);
   printf("Use new initial: 0x%X\n", newInitialRNG);
 }
@@ -0,0 +1,157 @@
+#include "argparse.hpp"
+#include "common.h"
+#include "SDLPopInstance.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <omp.h>
+#include <sstream>
+
+// Number of seeds evaluated side by side, one per vector lane
+#define _SEED_LANES 64
+
+// Seeds per work item handed to a thread, and per progress report
+#define _SEED_CHUNK_SIZE (1ull << 24)
+
+// prandom(max) advances the RNG and returns (seed >> 16) % (max + 1). A constraint expects the value drawn
+// after a given number of advances from the initial seed, with modulus = max + 1
+struct seedConstraint_t
+{
+  dword advances;
+  dword modulus;
+  dword value;
+
+  // The state after the advances, as an affine function of the initial seed
+  dword multiplier;
+  dword increment;
+
+  // Reciprocal for computing 16-bit remainders with multiplications only, which vectorize where divisions do not
+  dword reciprocal;
+};
+
+std::vector<seedConstraint_t> parseSeedConstraints(const std::string &constraintString)
+{
+  std::vector<seedConstraint_t> constraints;
+  std::istringstream stream(constraintString);
+  std::string entry;
+
+  while (std::getline(stream, entry, ','))
+  {
+    seedConstraint_t c;
+    if (sscanf(entry.c_str(), "%u:%u:%u", &c.advances, &c.modulus, &c.value) != 3) EXIT_WITH_ERROR("[ERROR] Invalid seed constraint '%s', expected advances:modulus:value.\n", entry.c_str());
+    if (c.advances == 0) EXIT_WITH_ERROR("[ERROR] Seed constraint '%s' must take at least one advance.\n", entry.c_str());
+    if (c.modulus == 0 || c.modulus > 65536) EXIT_WITH_ERROR("[ERROR] Seed constraint '%s' modulus must be between 1 and 65536.\n", entry.c_str());
+    if (c.value >= c.modulus) EXIT_WITH_ERROR("[ERROR] Seed constraint '%s' value must be lower than its modulus.\n", entry.c_str());
+
+    c.increment = SDLPopInstance::advanceRNGState(0, c.advances);
+    c.multiplier = SDLPopInstance::advanceRNGState(1, c.advances) - c.increment;
+    c.reciprocal = 0xFFFFFFFFu / c.modulus + 1;
+    constraints.push_back(c);
+  }
+
+  if (constraints.empty()) EXIT_WITH_ERROR("[ERROR] No seed constraints were given.\n");
+
+  // Checking the least likely constraints first, so most seeds are discarded by the first one
+  std::stable_sort(constraints.begin(), constraints.end(), [](const seedConstraint_t &a, const seedConstraint_t &b) { return a.modulus > b.modulus; });
+
+  return constraints;
+}
+
+// Evaluates the constraints over the seeds [firstSeed, firstSeed + _SEED_LANES), adding the matching ones to the list
+void searchSeedLanes(const std::vector<seedConstraint_t> &constraints, const dword firstSeed, std::vector<dword> &matches)
+{
+  alignas(64) dword isAlive[_SEED_LANES];
+  for (size_t lane = 0; lane < _SEED_LANES; lane++) isAlive[lane] = 1;
+
+  for (const auto &c : constraints)
+  {
+    dword anyAlive = 0;
+
+    #pragma omp simd reduction(| : anyAlive)
+    for (size_t lane = 0; lane < _SEED_LANES; lane++)
+    {
+      const dword draw = (c.multiplier * (firstSeed + (dword)lane) + c.increment) >> 16;
+      const dword remainder = (dword)(((uint64_t)(c.reciprocal * draw) * c.modulus) >> 32);
+      isAlive[lane] &= remainder == c.value;
+      anyAlive |= isAlive[lane];
+    }
+
+    // Leaving as soon as every lane has failed
+    if (anyAlive == 0) return;
+  }
+
+  for (size_t lane = 0; lane < _SEED_LANES; lane++)
+    if (isAlive[lane]) matches.push_back(firstSeed + (dword)lane);
+}
+
+void searchSeeds(const std::string &constraintString, const size_t maxResults)
+{
+  const auto constraints = parseSeedConstraints(constraintString);
+  const size_t chunkCount = (1ull << 32) / _SEED_CHUNK_SIZE;
+
+  printf("[Jaffar] Searching the 2^32 seed space over %d threads for %lu constraint(s)...\n", omp_get_max_threads(), constraints.size());
+
+  std::vector<dword> results;
+  std::atomic<size_t> chunksDone(0);
+  std::atomic<bool> isDone(false);
+  auto t0 = std::chrono::high_resolution_clock::now();
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (size_t chunkId = 0; chunkId < chunkCount; chunkId++)
+  {
+    if (isDone.load(std::memory_order_relaxed)) continue;
+
+    std::vector<dword> matches;
+    const uint64_t chunkStart = chunkId * _SEED_CHUNK_SIZE;
+    for (uint64_t seed = chunkStart; seed < chunkStart + _SEED_CHUNK_SIZE; seed += _SEED_LANES) searchSeedLanes(constraints, (dword)seed, matches);
+
+    #pragma omp critical
+    {
+      results.insert(results.end(), matches.begin(), matches.end());
+      if (maxResults > 0 && results.size() >= maxResults) isDone = true;
+
+      const size_t doneCount = ++chunksDone;
+      printf("[Jaffar] Searched %5.1f%% of the seed space, %lu matches so far...\r", 100.0 * doneCount / chunkCount, results.size());
+      fflush(stdout);
+    }
+  }
+
+  auto tf = std::chrono::high_resolution_clock::now();
+  const double elapsedSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+  const uint64_t searchedSeeds = chunksDone * _SEED_CHUNK_SIZE;
+
+  // With an early exit, these are the first matches found, which need not be the lowest seeds
+  std::sort(results.begin(), results.end());
+  if (maxResults > 0 && results.size() > maxResults) results.resize(maxResults);
+
+  printf("\n[Jaffar] Searched %lu seeds in %.3fs (%.0f seeds/s)%s.\n", searchedSeeds, elapsedSeconds, searchedSeeds / elapsedSeconds, searchedSeeds < (1ull << 32) ? ", stopped early" : "");
+  printf("[Jaffar] Matching seeds: %lu\n", results.size());
+  for (const auto seed : results) printf("0x%08X\n", seed);
+}
+
+int main(int argc, char *argv[])
+{
+  // Defining arguments
+  argparse::ArgumentParser program("jaffar-seedfind", JAFFAR_VERSION);
+
+  program.add_argument("constraints")
+    .help("Comma-separated advances:modulus:value constraints the draws from the initial RNG must meet. prandom(max) draws with modulus = max + 1.")
+    .required();
+
+  program.add_argument("--maxResults")
+    .help("Stops the seed search once this many matching seeds are found (0 searches the whole seed space).")
+    .default_value(std::string("16"));
+
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    fprintf(stderr, "[Jaffar] Error parsing command line arguments: %s\n%s", err.what(), program.help().str().c_str());
+    exit(-1);
+  }
+
+  searchSeeds(program.get<std::string>("constraints"), std::stoul(program.get<std::string>("--maxResults")));
+}
@@ -0,0 +1,225 @@
+#include "segmentSnapshot.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Soft-dirty bit of a /proc/self/pagemap entry
+#define _PAGEMAP_SOFT_DIRTY_BIT (1ull << 55)
+
+SegmentSnapshot::SegmentSnapshot(SDLPopInstance *sdlPop, const bool dirtyTracking)
+{
+  _sdlPop = sdlPop;
+  _segments = _sdlPop->getWritableSegments();
+
+  _segmentSize = 0;
+  for (const auto &segment : _segments) _segmentSize += segment.size;
+  _snapshotSize = _segmentSize + sizeof(instanceData_t);
+
+  // Heap-backed resources belong to the live instance. The sprite table and the file cache are kept whole, since
+  // their slots may be empty for now, and so is every other word that points into the heap
+  _preservedRegions.push_back({(char *)_sdlPop->chtab_addrs, sizeof(*_sdlPop->chtab_addrs)});
+  _preservedRegions.push_back({(char *)_sdlPop->_cachedFilePointerTable, sizeof(*_sdlPop->_cachedFilePointerTable)});
+  _preservedRegions.push_back({(char *)_sdlPop->_cachedFileBufferTable, sizeof(*_sdlPop->_cachedFileBufferTable)});
+  _preservedRegions.push_back({(char *)_sdlPop->_cachedFileBufferSizes, sizeof(*_sdlPop->_cachedFileBufferSizes)});
+  _preservedRegions.push_back({(char *)_sdlPop->_cachedFilePathTable, sizeof(*_sdlPop->_cachedFilePathTable)});
+  _preservedRegions.push_back({(char *)_sdlPop->_cachedFileCounter, sizeof(*_sdlPop->_cachedFileCounter)});
+  for (const auto heapPointer : _sdlPop->getHeapPointers()) _preservedRegions.push_back({(char *)heapPointer, sizeof(*heapPointer)});
+
+  size_t preservedSize = 0;
+  for (const auto &region : _preservedRegions) preservedSize += region.size;
+  _preservedData.resize(preservedSize);
+
+  _rewindData.resize(_snapshotSize);
+  _pageSize = sysconf(_SC_PAGESIZE);
+  if (dirtyTracking == false) return;
+
+  _pagemapFd = open("/proc/self/pagemap", O_RDONLY);
+  _clearRefsFd = open("/proc/self/clear_refs", O_WRONLY);
+
+  // Checking that the kernel actually sets the soft-dirty bits, by writing to a page after clearing them
+  bool isAvailable = _pagemapFd >= 0 && _clearRefsFd >= 0;
+  if (isAvailable)
+  {
+    clearDirtyPages();
+    volatile char *testByte = &_rewindData[0];
+    *testByte = 1;
+
+    uint64_t entry = 0;
+    const off_t entryOffset = (off_t)((uintptr_t)testByte / _pageSize * sizeof(uint64_t));
+    isAvailable = pread(_pagemapFd, &entry, sizeof(entry), entryOffset) == sizeof(entry) && (entry & _PAGEMAP_SOFT_DIRTY_BIT);
+  }
+
+  if (isAvailable == false)
+  {
+    fprintf(stderr, "[Jaffar] Soft-dirty page tracking is not available, segment snapshots will be copied whole.\n");
+    if (_pagemapFd >= 0) close(_pagemapFd);
+    if (_clearRefsFd >= 0) close(_clearRefsFd);
+    _pagemapFd = -1;
+    _clearRefsFd = -1;
+  }
+}
+
+SegmentSnapshot::~SegmentSnapshot()
+{
+  if (_pagemapFd >= 0) close(_pagemapFd);
+  if (_clearRefsFd >= 0) close(_clearRefsFd);
+}
+
+void SegmentSnapshot::save(char *snapshotData) const
+{
+  // Segments are large and contiguous, which is where memcpy uses its widest vector copies
+  size_t pos = 0;
+  for (const auto &segment : _segments)
+  {
+    memcpy(&snapshotData[pos], segment.ptr, segment.size);
+    pos += segment.size;
+  }
+
+  instanceData_t instanceData;
+  instanceData.prevDrawnRoom = _sdlPop->_prevDrawnRoom;
+  memcpy(instanceData.quickControl, _sdlPop->quick_control, sizeof(instanceData.quickControl));
+  instanceData.replayCurrTick = _sdlPop->replay_curr_tick;
+  memcpy(&snapshotData[pos], &instanceData, sizeof(instanceData));
+}
+
+std::string SegmentSnapshot::save() const
+{
+  std::string snapshotData;
+  snapshotData.resize(_snapshotSize);
+  save(&snapshotData[0]);
+  return snapshotData;
+}
+
+void SegmentSnapshot::load(const char *snapshotData)
+{
+  beginRestore();
+
+  size_t pos = 0;
+  for (const auto &segment : _segments)
+  {
+    memcpy(segment.ptr, &snapshotData[pos], segment.size);
+    pos += segment.size;
+  }
+
+  endRestore();
+  loadInstanceData(&snapshotData[pos]);
+}
+
+void SegmentSnapshot::beginRestore()
+{
+  _restoreLevel = *_sdlPop->current_level;
+
+  size_t pos = 0;
+  for (const auto &region : _preservedRegions)
+  {
+    memcpy(&_preservedData[pos], region.ptr, region.size);
+    pos += region.size;
+  }
+}
+
+void SegmentSnapshot::endRestore()
+{
+  size_t pos = 0;
+  for (const auto &region : _preservedRegions)
+  {
+    memcpy(region.ptr, &_preservedData[pos], region.size);
+    pos += region.size;
+  }
+
+  // The live sprites are those of the level before restoring. Loading others sets the next level, which is put back
+  if (*_sdlPop->current_level != _restoreLevel)
+  {
+    const word nextLevel = *_sdlPop->next_level;
+    _sdlPop->loadLevelSprites(*_sdlPop->current_level);
+    *_sdlPop->next_level = nextLevel;
+  }
+}
+
+void SegmentSnapshot::loadInstanceData(const char *instanceDataPtr)
+{
+  instanceData_t instanceData;
+  memcpy(&instanceData, instanceDataPtr, sizeof(instanceData));
+  _sdlPop->_prevDrawnRoom = instanceData.prevDrawnRoom;
+  memcpy(_sdlPop->quick_control, instanceData.quickControl, sizeof(instanceData.quickControl));
+  _sdlPop->replay_curr_tick = instanceData.replayCurrTick;
+  _sdlPop->updateLevelFeatures();
+}
+
+void SegmentSnapshot::setRewindPoint()
+{
+  save(&_rewindData[0]);
+  if (isDirtyTrackingEnabled()) clearDirtyPages();
+}
+
+void SegmentSnapshot::rewind()
+{
+  if (isDirtyTrackingEnabled() == false)
+  {
+    load(_rewindData.data());
+    _lastRewindSize = _snapshotSize;
+    return;
+  }
+
+  // Restoring the pages written since the rewind point, then clearing the bits our own writes just set
+  beginRestore();
+  _lastRewindSize = restoreDirtyPages();
+  endRestore();
+  clearDirtyPages();
+
+  // The instance-side state is small enough to always restore
+  loadInstanceData(&_rewindData[_segmentSize]);
+  _lastRewindSize += sizeof(instanceData_t);
+}
+
+char *SegmentSnapshot::getAddress(const size_t offset) const
+{
+  size_t pos = 0;
+  for (const auto &segment : _segments)
+  {
+    if (offset < pos + segment.size) return segment.ptr + (offset - pos);
+    pos += segment.size;
+  }
+  return nullptr;
+}
+
+void SegmentSnapshot::clearDirtyPages()
+{
+  // Writing "4" to clear_refs clears the soft-dirty bits of every page in the process
+  if (pwrite(_clearRefsFd, "4", 1, 0) != 1) EXIT_WITH_ERROR("[Error] Could not clear soft-dirty page bits.\n");
+}
+
+size_t SegmentSnapshot::restoreDirtyPages()
+{
+  size_t copiedBytes = 0;
+  size_t pos = 0;
+
+  for (const auto &segment : _segments)
+  {
+    const uintptr_t start = (uintptr_t)segment.ptr;
+    const uintptr_t end = start + segment.size;
+    const uintptr_t firstPage = start / _pageSize;
+    const uintptr_t lastPage = (end - 1) / _pageSize;
+    const size_t pageCount = lastPage - firstPage + 1;
+
+    _pagemapEntries.resize(pageCount);
+    const ssize_t readSize = pageCount * sizeof(uint64_t);
+    if (pread(_pagemapFd, _pagemapEntries.data(), readSize, firstPage * sizeof(uint64_t)) != readSize) EXIT_WITH_ERROR("[Error] Could not read the process page map.\n");
+
+    for (size_t page = 0; page < pageCount; page++)
+    {
+      if ((_pagemapEntries[page] & _PAGEMAP_SOFT_DIRTY_BIT) == 0) continue;
+
+      // Clipping the page to the segment, whose ends need not be page-aligned
+      const uintptr_t copyStart = std::max(start, (firstPage + page) * _pageSize);
+      const uintptr_t copyEnd = std::min(end, (firstPage + page + 1) * _pageSize);
+      memcpy((char *)copyStart, &_rewindData[pos + (copyStart - start)], copyEnd - copyStart);
+      copiedBytes += copyEnd - copyStart;
+    }
+
+    pos += segment.size;
+  }
+
+  return copiedBytes;
+}
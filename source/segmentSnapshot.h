@@ -0,0 +1,80 @@
+#pragma once
+
+#include "SDLPopInstance.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Byte-exact snapshots of an SDLPop instance: the whole writable sdlPopLib memory plus the instance-side
+// state, as opposed to the curated item map that State saves. Snapshots are much larger than state frames,
+// but restoring one leaves the game state exactly as it was, so they can be used to validate the item map.
+// Heap resources are not part of the game state: pointers to them (sprites, file cache, surfaces) keep their
+// live values upon restoring, and the level sprites are loaded again if the restored level is a different one.
+class SegmentSnapshot
+{
+  public:
+  // With dirty tracking, rewinds only copy the memory pages written since the rewind point was set,
+  // using the kernel soft-dirty page bits. Falls back to whole-segment copies if they are not available.
+  // Setting a rewind point clears the soft-dirty bits of the entire process, so only one dirty tracking
+  // snapshot should be in use at a time.
+  SegmentSnapshot(SDLPopInstance *sdlPop, const bool dirtyTracking = false);
+  ~SegmentSnapshot();
+
+  // Size of a snapshot, in bytes
+  size_t getSize() const { return _snapshotSize; }
+
+  // Copies the live memory into a snapshot buffer of getSize() bytes, and back
+  void save(char *snapshotData) const;
+  std::string save() const;
+  void load(const char *snapshotData);
+
+  // Stores the live memory as the rewind point and brings it back to it
+  void setRewindPoint();
+  void rewind();
+
+  bool isDirtyTrackingEnabled() const { return _pagemapFd >= 0; }
+
+  // Bytes copied by the last rewind
+  size_t getLastRewindSize() const { return _lastRewindSize; }
+
+  // Live address of the byte at the given snapshot offset, or nullptr if it belongs to the instance-side state
+  char *getAddress(const size_t offset) const;
+
+  private:
+  SDLPopInstance *_sdlPop;
+  std::vector<SDLPopInstance::segment_t> _segments;
+  size_t _segmentSize;
+  size_t _snapshotSize;
+
+  // Instance-side state, stored after the segments
+  struct instanceData_t
+  {
+    word prevDrawnRoom;
+    char quickControl[sizeof(SDLPopInstance::quick_control)];
+    float replayCurrTick;
+  };
+
+  std::string _rewindData;
+  size_t _lastRewindSize = 0;
+
+  // Soft-dirty page tracking
+  int _pagemapFd = -1;
+  int _clearRefsFd = -1;
+  size_t _pageSize;
+  std::vector<uint64_t> _pagemapEntries;
+
+  // Clears the soft-dirty bits, and restores the pages written since then from the rewind point
+  void clearDirtyPages();
+  size_t restoreDirtyPages();
+
+  void loadInstanceData(const char *instanceDataPtr);
+
+  // Live memory kept out of restores, and its contents while a restore is under way
+  std::vector<SDLPopInstance::segment_t> _preservedRegions;
+  std::string _preservedData;
+
+  // Keeps the preserved regions while restoring, and loads the level sprites if the level changed
+  void beginRestore();
+  void endRestore();
+  word _restoreLevel;
+};
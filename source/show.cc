@@ -13,6 +13,10 @@ int main(int argc, char *argv[])
     .help("path to the Prince of Persia Save file (.sav) to display.")
     .required();
 
+  program.add_argument("--stateIndex")
+    .help("If the save file is a state container, index of the state to display. Negative values count from the end.")
+    .default_value(std::string("-1"));
+
   // Parsing command line
   try
   {
@@ -33,15 +37,18 @@ int main(int argc, char *argv[])
   // Getting savefile path
   std::string saveFilePath = program.get<std::string>("saveFile");
 
-  // Loading save file contents
-  std::string saveString;
-  bool status = loadStringFromFile(saveString, saveFilePath.c_str());
-  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not load save state from file: %s\n", saveFilePath.c_str());
+  // Getting state index for state containers
+  const long stateIndex = std::stol(program.get<std::string>("--stateIndex"));
 
   // Initializing showing SDLPop Instance
   SDLPopInstance showSDLPop("libsdlPopLib.so", false);
   showSDLPop.initialize(true);
 
+  // Loading save file contents
+  std::string saveString;
+  bool status = State::loadFrameFromFile(showSDLPop, saveFilePath.c_str(), stateIndex, saveString);
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not load save state from file: %s\n", saveFilePath.c_str());
+
   // Initializing State Handler
   State showState(&showSDLPop, saveString);
 
@@ -57,9 +64,9 @@ int main(int argc, char *argv[])
   {
     // Reloading save file
     std::string saveData;
-    bool status = loadStringFromFile(saveData, saveFilePath.c_str());
+    bool status = State::loadFrameFromFile(showSDLPop, saveFilePath.c_str(), stateIndex, saveData);
 
-    if (status == true && saveData.size() == _FRAME_DATA_SIZE)
+    if (status == true)
     {
       // Loading data into state
       showState.loadState(saveData);
@@ -0,0 +1,52 @@
+#include "argparse.hpp"
+#include "common.h"
+#include "move.h"
+#include "utils.h"
+
+int main(int argc, char *argv[])
+{
+  // Defining arguments
+  argparse::ArgumentParser program("jaffar-solconv", JAFFAR_VERSION);
+
+  program.add_argument("inputFile")
+    .help("Path to the solution file to convert. Text (.sol) files are converted to binary (.solb) and vice versa.")
+    .required();
+
+  program.add_argument("outputFile")
+    .help("Path to the converted solution file to produce.")
+    .required();
+
+  // Parsing command line
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    fprintf(stderr, "[Jaffar] Error parsing command line arguments: %s\n%s", err.what(), program.help().str().c_str());
+    exit(-1);
+  }
+
+  // Getting arguments
+  std::string inputFile = program.get<std::string>("inputFile");
+  std::string outputFile = program.get<std::string>("outputFile");
+  const bool isBinaryInput = isSolutionFile(inputFile.c_str());
+
+  // Loading solution
+  std::vector<Move> moveList;
+  bool status = loadSolutionFile(moveList, inputFile.c_str());
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not find or read from solution file: %s\n", inputFile.c_str());
+
+  // Binary files become text, and text files become binary
+  if (isBinaryInput == true)
+  {
+    std::string moveSequence;
+    for (const auto move : moveList) moveSequence += moveToString(move) + " ";
+    status = saveStringToFile(moveSequence, outputFile.c_str());
+  }
+
+  if (isBinaryInput == false) status = saveSolutionFile(moveList, outputFile.c_str());
+
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not write solution file: %s\n", outputFile.c_str());
+  printf("[Jaffar] %lu moves converted to %s format in '%s'.\n", moveList.size(), isBinaryInput ? "text" : "binary", outputFile.c_str());
+}
@@ -1,114 +1,148 @@
 #include "state.h"
 #include "common.h"
 #include "utils.h"
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+// Highest level number stored in LEVELS.DAT
+#define _MAX_LEVEL_ID 15
+
+// Equal bytes that end a run in the compact level diff
+#define _LEVEL_DIFF_MAX_GAP 4
 
 size_t _currentStep;
-char quick_control[] = "........";
-float replay_curr_tick = 0.0;
-
-template <class T>
-void AddItem(std::vector<State::Item> *dest, T &val, State::ItemType type)
-{
-  dest->push_back({&val, sizeof(val), type});
-}
-
-std::vector<State::Item> GenerateItemsMap(SDLPopInstance *sdlPop)
-{
-  std::vector<State::Item> dest;
-  AddItem(&dest, quick_control, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->level, State::HASHABLE_MANUAL);
-  AddItem(&dest, *sdlPop->checkpoint, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->upside_down, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->drawn_room, State::HASHABLE);
-  AddItem(&dest, *sdlPop->current_level, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->next_level, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->mobs_count, State::HASHABLE_MANUAL);
-  AddItem(&dest, *sdlPop->mobs, State::HASHABLE_MANUAL);
-  AddItem(&dest, *sdlPop->trobs_count, State::HASHABLE_MANUAL);
-  AddItem(&dest, *sdlPop->trobs, State::HASHABLE_MANUAL);
-  AddItem(&dest, *sdlPop->leveldoor_open, State::HASHABLE);
-  AddItem(&dest, *sdlPop->Kid, State::HASHABLE);
-  AddItem(&dest, *sdlPop->hitp_curr, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->hitp_max, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->hitp_beg_lev, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->grab_timer, State::HASHABLE);
-  AddItem(&dest, *sdlPop->holding_sword, State::HASHABLE);
-  AddItem(&dest, *sdlPop->united_with_shadow, State::HASHABLE);
-  AddItem(&dest, *sdlPop->have_sword, State::HASHABLE);
-  /*AddItem(&dest, *sdlPop->ctrl1_forward, State::HASHABLE);
-  AddItem(&dest, *sdlPop->ctrl1_backward, State::HASHABLE);
-  AddItem(&dest, *sdlPop->ctrl1_up, State::HASHABLE);
-  AddItem(&dest, *sdlPop->ctrl1_down, State::HASHABLE);
-  AddItem(&dest, *sdlPop->ctrl1_shift2, State::HASHABLE);*/
-  AddItem(&dest, *sdlPop->kid_sword_strike, State::HASHABLE);
-  AddItem(&dest, *sdlPop->pickup_obj_type, State::HASHABLE);
-  AddItem(&dest, *sdlPop->offguard, State::HASHABLE);
-  // guard
-  AddItem(&dest, *sdlPop->Guard, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->Char, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->Opp, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->guardhp_curr, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->guardhp_max, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->demo_index, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->demo_time, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->curr_guard_color, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->guard_notice_timer, State::HASHABLE);
-  AddItem(&dest, *sdlPop->guard_skill, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->shadow_initialized, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->guard_refrac, State::HASHABLE);
-  AddItem(&dest, *sdlPop->justblocked, State::HASHABLE);
-  AddItem(&dest, *sdlPop->droppedout, State::HASHABLE);
-  // collision
-  AddItem(&dest, *sdlPop->curr_row_coll_room, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->curr_row_coll_flags, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->below_row_coll_room, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->below_row_coll_flags, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->above_row_coll_room, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->above_row_coll_flags, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->prev_collision_row, State::PER_FRAME_STATE);
-  // flash
-  AddItem(&dest, *sdlPop->flash_color, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->flash_time, State::PER_FRAME_STATE);
-  // sounds
-  AddItem(&dest, *sdlPop->need_level1_music, State::HASHABLE);
-  AddItem(&dest, *sdlPop->is_screaming, State::HASHABLE);
-  AddItem(&dest, *sdlPop->is_feather_fall, State::HASHABLE);
-  AddItem(&dest, *sdlPop->last_loose_sound, State::HASHABLE);
-  // AddItem(&dest, *sdlPop->next_sound, State::HASHABLE);
-  // AddItem(&dest, *sdlPop->current_sound, State::HASHABLE);
-  // random
-  AddItem(&dest, *sdlPop->random_seed, State::PER_FRAME_STATE);
-  // remaining time
-  AddItem(&dest, *sdlPop->rem_min, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->rem_tick, State::PER_FRAME_STATE);
-  // saved controls
-  AddItem(&dest, *sdlPop->control_x, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->control_y, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->control_shift, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->control_forward, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->control_backward, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->control_up, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->control_down, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->control_shift2, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->ctrl1_forward, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->ctrl1_backward, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->ctrl1_up, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->ctrl1_down, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->ctrl1_shift2, State::PER_FRAME_STATE);
-  // Support for overflow glitch
-  AddItem(&dest, *sdlPop->exit_room_timer, State::PER_FRAME_STATE);
-  // replay recording state
-  AddItem(&dest, replay_curr_tick, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->is_guard_notice, State::PER_FRAME_STATE);
-  AddItem(&dest, *sdlPop->can_guard_see_kid, State::PER_FRAME_STATE);
-  return dest;
-}
-
-State::State(SDLPopInstance *sdlPop, const std::string& saveString)
+
+// Macros to describe a state item, either stored in the sdlPopLib or in the SDLPop instance object. The item
+// offsets in the frame data come from the StateData fields generated from the same schema
+#define SDLPOP_ITEM(NAME, TYPE) \
+  { #NAME, sizeof(StateData::NAME), offsetof(StateData, NAME), State::TYPE, [](SDLPopInstance *sdlPop) -> void * { return sdlPop->NAME; }, nullptr },
+
+#define SDLPOP_MANUAL_ITEM(NAME, HANDLER) \
+  { #NAME, sizeof(StateData::NAME), offsetof(StateData, NAME), State::HASHABLE_MANUAL, [](SDLPopInstance *sdlPop) -> void * { return sdlPop->NAME; }, HANDLER },
+
+#define INSTANCE_ITEM(NAME, TYPE) \
+  { #NAME, sizeof(StateData::NAME), offsetof(StateData, NAME), State::TYPE, [](SDLPopInstance *sdlPop) -> void * { return &sdlPop->NAME; }, nullptr },
+
+// Manual hash handlers. These only consider the parts of an item that can change during a level
+
+void hashLevel(Hasher &hasher, SDLPopInstance *sdlPop)
+{
+  const auto &level = *sdlPop->level;
+
+  // Tile states (doors, gates, loose tiles, debris, etc)
+  hasher.update(level.fg);
+  hasher.update(level.bg);
+
+  // Guards leaving their rooms update their starting information
+  hasher.update(level.guards_tile);
+  hasher.update(level.guards_dir);
+  hasher.update(level.guards_x);
+  hasher.update(level.guards_seq_lo);
+  hasher.update(level.guards_seq_hi);
+}
+
+void hashMobsCount(Hasher &hasher, SDLPopInstance *sdlPop)
+{
+  hasher.update(*sdlPop->mobs_count);
+}
+
+void hashMobs(Hasher &hasher, SDLPopInstance *sdlPop)
+{
+  // Only live mobs are considered
+  hasher.update(*sdlPop->mobs, *sdlPop->mobs_count * sizeof(mob_type));
+}
+
+void hashTrobsCount(Hasher &hasher, SDLPopInstance *sdlPop)
+{
+  hasher.update(*sdlPop->trobs_count);
+}
+
+void hashTrobs(Hasher &hasher, SDLPopInstance *sdlPop)
+{
+  // Only live trobs are considered
+  hasher.update(*sdlPop->trobs, *sdlPop->trobs_count * sizeof(trob_type));
+}
+
+// Compile-time state schema, in the order given by STATE_ITEMS
+constexpr State::ItemSpec _itemSchema[] = {
+  STATE_ITEMS(SDLPOP_ITEM, SDLPOP_MANUAL_ITEM, INSTANCE_ITEM)
+};
+
+constexpr size_t _itemSchemaCount = sizeof(_itemSchema) / sizeof(State::ItemSpec);
+
+// The items must follow each other in the frame data and cover it without gaps
+constexpr bool isItemSchemaValid()
+{
+  size_t offset = 0;
+  for (size_t i = 0; i < _itemSchemaCount; i++)
+  {
+    if (_itemSchema[i].offset != offset) return false;
+    offset += _itemSchema[i].size;
+  }
+  return offset == _FRAME_DATA_SIZE;
+}
+
+static_assert(isItemSchemaValid(), "State schema does not match the StateData layout");
+
+size_t State::getItemSpecCount()
+{
+  return _itemSchemaCount;
+}
+
+const State::ItemSpec &State::getItemSpec(const size_t idx)
+{
+  return _itemSchema[idx];
+}
+
+uint64_t State::getLayoutHash()
+{
+  Hasher hasher;
+  for (size_t i = 0; i < _itemSchemaCount; i++)
+  {
+    hasher.update(_itemSchema[i].name, strlen(_itemSchema[i].name));
+    hasher.update((uint64_t)_itemSchema[i].size);
+    hasher.update((uint32_t)_itemSchema[i].type);
+  }
+  return hasher.digest();
+}
+
+// Adds an item to a list of runs, extending the last run if the item starts right where it ends
+void AddToRuns(std::vector<State::CopyRun> *runs, void *ptr, const size_t size, const size_t offset)
+{
+  if (runs->empty() == false && (char *)runs->back().ptr + runs->back().size == ptr)
+    runs->back().size += size;
+  else
+    runs->push_back({ptr, size, offset});
+}
+
+// Binds the schema to the given SDLPop instance, coalescing items that are adjacent in memory into runs
+void BindItemsMap(SDLPopInstance *sdlPop, std::vector<State::Item> *items, std::vector<State::CopyRun> *copyRuns, std::vector<State::CopyRun> *hashRuns, std::vector<State::HashHandler> *hashHandlers)
+{
+  for (size_t i = 0; i < _itemSchemaCount; i++)
+  {
+    const auto &spec = _itemSchema[i];
+    void *ptr = spec.bind(sdlPop);
+    items->push_back({spec.name, ptr, spec.size, spec.type, spec.offset});
+
+    AddToRuns(copyRuns, ptr, spec.size, spec.offset);
+    if (spec.type == State::HASHABLE) AddToRuns(hashRuns, ptr, spec.size, spec.offset);
+    if (spec.type == State::HASHABLE_MANUAL) hashHandlers->push_back(spec.hash);
+  }
+}
+
+State::State(SDLPopInstance *sdlPop)
 {
   _sdlPop = sdlPop;
-  _items = GenerateItemsMap(sdlPop);
+  BindItemsMap(sdlPop, &_items, &_copyRuns, &_hashRuns, &_hashHandlers);
+
+  // Rollbacks cover every part of the state
+  for (const auto &run : _copyRuns) _sdlPop->addRollbackRegion(run.ptr, run.size);
+}
 
+State::State(SDLPopInstance *sdlPop, const std::string_view saveString) : State(sdlPop)
+{
   // Update the SDLPop instance with the savefile contents
   loadState(saveString);
   _sdlPop->startLevel(*_sdlPop->next_level);
@@ -128,37 +162,204 @@ State::State(SDLPopInstance *sdlPop, const std::string& saveString)
   *_sdlPop->last_loose_sound = looseTileSound;
 }
 
-void State::loadState(const std::string &data)
+void State::loadState(const std::string_view data)
 {
   if (data.size() != _FRAME_DATA_SIZE)
     EXIT_WITH_ERROR("[Error] Wrong state size. Expected %lu, got: %lu\n", _FRAME_DATA_SIZE, data.size());
 
-  size_t curPos = 0;
-  for (const auto &item : _items)
+  loadState(*(const StateData *)data.data());
+}
+
+void State::loadState(const StateData &data)
+{
+  const char *frameData = (const char *)&data;
+  const word prevDrawnRoom = *_sdlPop->drawn_room;
+  bool roomLinksChanged = true;
+
+  if (_differentialLoad == false)
+    for (const auto &run : _copyRuns) memcpy(run.ptr, &frameData[run.offset], run.size);
+
+  if (_differentialLoad == true)
   {
-    memcpy(item.ptr, &data.c_str()[curPos], item.size);
-    curPos += item.size;
+    roomLinksChanged = memcmp(_sdlPop->level->roomlinks, data.level.roomlinks, sizeof(data.level.roomlinks)) != 0;
+
+    // Only copying the items that differ. memcmp already compares with vector instructions
+    for (const auto &item : _items)
+      if (memcmp(item.ptr, &frameData[item.offset], item.size) != 0) memcpy(item.ptr, &frameData[item.offset], item.size);
   }
 
-  _sdlPop->isExitDoorOpen = _sdlPop->isLevelExitDoorOpen();
-  *_sdlPop->different_room = 1;
-  // Show the room where the prince is, even if the player moved the view away
-  // from it (with the H,J,U,N keys).
-  *_sdlPop->next_room = *_sdlPop->drawn_room = _sdlPop->Kid->room;
-  _sdlPop->load_room_links();
+  _sdlPop->finishStateLoad(prevDrawnRoom, roomLinksChanged);
 }
 
 std::string State::saveState() const
 {
   std::string res;
-  res.reserve(_FRAME_DATA_SIZE);
-  for (const auto &item : _items)
+  res.resize(_FRAME_DATA_SIZE);
+  saveState(&res[0]);
+  return res;
+}
+
+void State::saveState(char *frameData) const
+{
+  saveState(*(StateData *)frameData);
+}
+
+void State::saveState(StateData &data) const
+{
+  char *frameData = (char *)&data;
+  for (const auto &run : _copyRuns) memcpy(&frameData[run.offset], run.ptr, run.size);
+}
+
+uint64_t State::computeHash() const
+{
+  Hasher hasher;
+  for (const auto &run : _hashRuns) hasher.update(run.ptr, run.size);
+  for (const auto &handler : _hashHandlers) handler(hasher, _sdlPop);
+  return hasher.digest();
+}
+
+const level_type &State::getReferenceLevel(const SDLPopInstance &sdlPop, const word levelId)
+{
+  static const level_type emptyLevel = {};
+  if (levelId > _MAX_LEVEL_ID) return emptyLevel;
+  return sdlPop.getPristineLevel(levelId);
+}
+
+size_t State::getMaxCompactStateSize()
+{
+  // Every run but the last is followed by more than _LEVEL_DIFF_MAX_GAP unchanged bytes or is 255 bytes long
+  const size_t levelSize = sizeof(level_type);
+  const size_t maxRunCount = levelSize / (_LEVEL_DIFF_MAX_GAP + 1) + 1;
+  return _FRAME_DATA_SIZE + sizeof(uint16_t) + maxRunCount * (sizeof(uint16_t) + sizeof(uint8_t));
+}
+
+// Compact format: [frame data without the level][run count] and, per run: [level offset][length][bytes]
+void State::encodeCompactState(const SDLPopInstance &sdlPop, const char *frameData, std::string &compactData)
+{
+  const auto &data = *(const StateData *)frameData;
+  const size_t levelSize = sizeof(level_type);
+  const size_t levelEnd = offsetof(StateData, level) + levelSize;
+
+  compactData.clear();
+  compactData.append(frameData, offsetof(StateData, level));
+  compactData.append(frameData + levelEnd, _FRAME_DATA_SIZE - levelEnd);
+
+  const uint8_t *reference = (const uint8_t *)&getReferenceLevel(sdlPop, data.current_level);
+  const uint8_t *current = (const uint8_t *)&data.level;
+
+  // Reserving space for the run count
+  const size_t runCountPos = compactData.size();
+  uint16_t runCount = 0;
+  compactData.append(sizeof(runCount), '\0');
+
+  size_t pos = 0;
+  while (pos < levelSize)
   {
-    res.append(reinterpret_cast<const char *>(item.ptr), item.size);
+    if (current[pos] == reference[pos])
+    {
+      pos++;
+      continue;
+    }
+
+    // A run ends after a few equal bytes in a row, or when reaching the maximum length
+    size_t runEnd = pos + 1;
+    size_t lastDiff = pos;
+    while (runEnd < levelSize && runEnd - pos < 255 && runEnd - lastDiff <= _LEVEL_DIFF_MAX_GAP)
+    {
+      if (current[runEnd] != reference[runEnd]) lastDiff = runEnd;
+      runEnd++;
+    }
+
+    const uint16_t runOffset = pos;
+    const uint8_t runLength = lastDiff - pos + 1;
+    compactData.append((const char *)&runOffset, sizeof(runOffset));
+    compactData.append((const char *)&runLength, sizeof(runLength));
+    compactData.append((const char *)current + pos, runLength);
+    runCount++;
+
+    pos += runLength;
   }
 
-  if (res.size() != _FRAME_DATA_SIZE)
-    EXIT_WITH_ERROR("[Error] Wrong state size. Expected %lu, got: %lu\n", _FRAME_DATA_SIZE, res.size());
+  memcpy(&compactData[runCountPos], &runCount, sizeof(runCount));
+}
 
-  return res;
+void State::decodeCompactState(const SDLPopInstance &sdlPop, const std::string_view compactData, char *frameData)
+{
+  const size_t levelSize = sizeof(level_type);
+  const size_t levelEnd = offsetof(StateData, level) + levelSize;
+  const size_t fixedSize = _FRAME_DATA_SIZE - levelSize;
+
+  if (compactData.size() < fixedSize + sizeof(uint16_t))
+    EXIT_WITH_ERROR("[Error] Compact state too short. Expected at least %lu, got: %lu\n", fixedSize + sizeof(uint16_t), compactData.size());
+
+  // Restoring everything but the level
+  memcpy(frameData, compactData.data(), offsetof(StateData, level));
+  memcpy(frameData + levelEnd, compactData.data() + offsetof(StateData, level), _FRAME_DATA_SIZE - levelEnd);
+
+  // Rebuilding the level from its pristine version
+  auto &data = *(StateData *)frameData;
+  data.level = getReferenceLevel(sdlPop, data.current_level);
+
+  size_t pos = fixedSize;
+  uint16_t runCount;
+  memcpy(&runCount, compactData.data() + pos, sizeof(runCount));
+  pos += sizeof(runCount);
+
+  for (uint16_t i = 0; i < runCount; i++)
+  {
+    uint16_t runOffset;
+    uint8_t runLength;
+    if (pos + sizeof(runOffset) + sizeof(runLength) > compactData.size()) EXIT_WITH_ERROR("[Error] Truncated compact state.\n");
+    memcpy(&runOffset, compactData.data() + pos, sizeof(runOffset));
+    pos += sizeof(runOffset);
+    memcpy(&runLength, compactData.data() + pos, sizeof(runLength));
+    pos += sizeof(runLength);
+
+    if (pos + runLength > compactData.size() || runOffset + runLength > levelSize) EXIT_WITH_ERROR("[Error] Corrupted compact state.\n");
+    memcpy((char *)&data.level + runOffset, compactData.data() + pos, runLength);
+    pos += runLength;
+  }
+}
+
+void State::addToStateFile(StateFileWriter &writer, const char *frameData) const
+{
+  std::string compactData;
+  encodeCompactState(*_sdlPop, frameData, compactData);
+  writer.add(compactData, hashBuffer(frameData, _FRAME_DATA_SIZE));
+}
+
+void State::getFromStateFile(const SDLPopInstance &sdlPop, const StateFileReader &reader, const size_t ordinal, char *frameData)
+{
+  const auto &header = reader.getHeader();
+  if (header.schemaVersion != _STATE_SCHEMA_VERSION || header.layoutHash != getLayoutHash())
+    EXIT_WITH_ERROR("[Error] State file layout (schema version %u, hash 0x%016lX) does not match the current one (schema version %u, hash 0x%016lX)\n", header.schemaVersion, header.layoutHash, _STATE_SCHEMA_VERSION, getLayoutHash());
+  if (header.recordSize > getMaxCompactStateSize())
+    EXIT_WITH_ERROR("[Error] State file record size %u exceeds the largest compact state (%lu)\n", header.recordSize, getMaxCompactStateSize());
+
+  std::string compactData;
+  reader.get(ordinal, compactData);
+  decodeCompactState(sdlPop, compactData, frameData);
+}
+
+bool State::loadFrameFromFile(const SDLPopInstance &sdlPop, const char *fileName, const long stateIndex, std::string &frameData)
+{
+  if (isStateFile(fileName) == false)
+    return loadStringFromFile(frameData, fileName) && frameData.size() == _FRAME_DATA_SIZE;
+
+  try
+  {
+    StateFileReader reader(fileName);
+    const long ordinal = stateIndex < 0 ? (long)reader.size() + stateIndex : stateIndex;
+    if (ordinal < 0 || ordinal >= (long)reader.size()) return false;
+
+    frameData.resize(_FRAME_DATA_SIZE);
+    getFromStateFile(sdlPop, reader, ordinal, &frameData[0]);
+  }
+  catch (const std::runtime_error &err)
+  {
+    fprintf(stderr, "[Jaffar] Could not read state file %s: %s", fileName, err.what());
+    return false;
+  }
+
+  return true;
 }
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "SDLPopInstance.h"
+#include "hash.h"
+#include "stateData.h"
+#include "utils.h"
 #include <cstddef>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // Current train step is a global variable so every part of the code can see it
@@ -18,20 +22,98 @@ class State
     HASHABLE_MANUAL,
   };
 
+  // Custom hash handler for HASHABLE_MANUAL items
+  typedef void (*HashHandler)(Hasher &hasher, SDLPopInstance *sdlPop);
+
+  // Compile-time description of a state item: name, size, offset in the frame data, type and how to find it in a given SDLPop instance
+  struct ItemSpec
+  {
+    const char *name;
+    size_t size;
+    size_t offset;
+    ItemType type;
+    void *(*bind)(SDLPopInstance *sdlPop);
+    HashHandler hash;
+  };
+
+  // State item, once bound to a given SDLPop instance
   struct Item
   {
+    const char *name;
     void *ptr;
     size_t size;
     ItemType type;
+    size_t offset;
+  };
+
+  // Run of items that are contiguous both in the frame data and in the sdlPopLib data segment
+  struct CopyRun
+  {
+    void *ptr;
+    size_t size;
+    size_t offset;
   };
 
   State() = default;
-  State(SDLPopInstance *sdlPop, const std::string& saveString);
+  State(SDLPopInstance *sdlPop, const std::string_view saveString);
+
+  // Binds the state handler to an SDLPop instance without loading any data into it
+  State(SDLPopInstance *sdlPop);
 
-  void loadState(const std::string &data);
+  void loadState(const std::string_view data);
   std::string saveState() const;
 
+  // Saves the state directly into a buffer of _FRAME_DATA_SIZE bytes (e.g., a StateArena slot)
+  void saveState(char *frameData) const;
+
+  // Loads and saves the frame data as a StateData struct. The other overloads go through these
+  void loadState(const StateData &data);
+  void saveState(StateData &data) const;
+
+  // In differential mode, loadState compares every item against the live state and only copies those that
+  // differ. Room links are only reloaded if the drawn room or the level layout changed, or if the live room
+  // pointers were moved to another room since they were last loaded. The result is the same as a full load.
+  void setDifferentialLoad(const bool differentialLoad) { _differentialLoad = differentialLoad; }
+
+  // Compact encoding of a frame: the level is stored as a sparse diff against the pristine level
+  // of the current level number, which gets rebuilt upon decoding. The instance only provides the pristine levels
+  static void encodeCompactState(const SDLPopInstance &sdlPop, const char *frameData, std::string &compactData);
+  static void decodeCompactState(const SDLPopInstance &sdlPop, const std::string_view compactData, char *frameData);
+
+  // Largest size of a compact encoding, used as record size for state containers
+  static size_t getMaxCompactStateSize();
+
+  // Stores a frame in a state container (compact encoding, identified by the hash of its frame data)
+  void addToStateFile(StateFileWriter &writer, const char *frameData) const;
+
+  // Retrieves a frame from a state container, checking that its layout matches the current schema
+  static void getFromStateFile(const SDLPopInstance &sdlPop, const StateFileReader &reader, const size_t ordinal, char *frameData);
+
+  // Loads frame data from a raw savefile or, for state containers, the state at the given ordinal (negative values count from the end)
+  static bool loadFrameFromFile(const SDLPopInstance &sdlPop, const char *fileName, const long stateIndex, std::string &frameData);
+
+  // Computes the hash of the HASHABLE and HASHABLE_MANUAL items directly from the SDLPop instance memory
+  uint64_t computeHash() const;
+
+  // Accessors to the bound item map and its coalesced copy runs
+  const std::vector<Item> &getItems() const { return _items; }
+  const std::vector<CopyRun> &getCopyRuns() const { return _copyRuns; }
+
+  // Accessors to the compile-time state schema
+  static size_t getItemSpecCount();
+  static const ItemSpec &getItemSpec(const size_t idx);
+
+  // Hash of the item names, sizes and types, identifying the frame data layout
+  static uint64_t getLayoutHash();
+
   private:
   SDLPopInstance *_sdlPop;
+  bool _differentialLoad = false;
+
+  // Gets the level that compact encodings take as reference for a given level number
+  static const level_type &getReferenceLevel(const SDLPopInstance &sdlPop, const word levelId);
   std::vector<Item> _items;
+  std::vector<CopyRun> _copyRuns;
+  std::vector<CopyRun> _hashRuns;
+  std::vector<HashHandler> _hashHandlers;
 };
@@ -0,0 +1,46 @@
+#include "stateArena.h"
+#include "utils.h"
+#include <cstdlib>
+
+// Slots and blocks are aligned to cache lines
+#define _STATE_ARENA_ALIGNMENT 64
+
+StateArena::StateArena(const size_t slotSize, const size_t slotsPerBlock)
+{
+  if (slotSize == 0 || slotsPerBlock == 0) EXIT_WITH_ERROR("[Error] State arena slot size and slots per block must be positive.\n");
+
+  _slotSize = slotSize;
+  _slotStride = ((slotSize + _STATE_ARENA_ALIGNMENT - 1) / _STATE_ARENA_ALIGNMENT) * _STATE_ARENA_ALIGNMENT;
+  _slotsPerBlock = slotsPerBlock;
+  _slotCount = 0;
+}
+
+StateArena::~StateArena()
+{
+  for (auto block : _blocks) free(block);
+}
+
+size_t StateArena::allocate()
+{
+  if (_freeSlots.empty() == false)
+  {
+    size_t slotId = _freeSlots.back();
+    _freeSlots.pop_back();
+    return slotId;
+  }
+
+  // Adding a new block if the current ones are full
+  if (_slotCount == _blocks.size() * _slotsPerBlock)
+  {
+    char *block = (char *)aligned_alloc(_STATE_ARENA_ALIGNMENT, _slotsPerBlock * _slotStride);
+    if (block == NULL) EXIT_WITH_ERROR("[Error] Could not allocate %lu bytes for the state arena.\n", _slotsPerBlock * _slotStride);
+    _blocks.push_back(block);
+  }
+
+  return _slotCount++;
+}
+
+void StateArena::release(const size_t slotId)
+{
+  _freeSlots.push_back(slotId);
+}
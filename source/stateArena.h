@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common.h"
+#include <cstddef>
+#include <vector>
+
+// Pool of fixed-size state slots, allocated in large cache-line aligned blocks.
+// Slots are identified by their index and remain at the same address for the lifetime of the arena.
+class StateArena
+{
+  public:
+  StateArena(const size_t slotSize = _FRAME_DATA_SIZE, const size_t slotsPerBlock = 4096);
+  ~StateArena();
+
+  StateArena(const StateArena &) = delete;
+  StateArena &operator=(const StateArena &) = delete;
+
+  // Obtains a free slot, reusing previously released ones first
+  size_t allocate();
+
+  // Returns a slot to the pool
+  void release(const size_t slotId);
+
+  // Gets the memory of a given slot
+  char *getSlot(const size_t slotId) const
+  {
+    return _blocks[slotId / _slotsPerBlock] + (slotId % _slotsPerBlock) * _slotStride;
+  }
+
+  // Number of usable bytes per slot
+  size_t getSlotSize() const { return _slotSize; }
+
+  // Slots currently in use
+  size_t getSlotCount() const { return _slotCount - _freeSlots.size(); }
+
+  // Bytes reserved by the arena
+  size_t getMemoryUsage() const { return _blocks.size() * _slotsPerBlock * _slotStride; }
+
+  private:
+  size_t _slotSize;
+  size_t _slotStride;
+  size_t _slotsPerBlock;
+  size_t _slotCount;
+  std::vector<char *> _blocks;
+  std::vector<size_t> _freeSlots;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "SDLPopInstance.h"
+#include "common.h"
+#include <type_traits>
+
+// State schema: every item of the frame data, in order. SDLPop items live in the sdlPopLib and are reached through
+// the instance symbol pointers, instance items live in the SDLPopInstance object itself. The second argument is the
+// item type, or the hash handler for manually hashed items.
+#define STATE_ITEMS(SDLPOP_ITEM, SDLPOP_MANUAL_ITEM, INSTANCE_ITEM) \
+  INSTANCE_ITEM(quick_control, PER_FRAME_STATE) \
+  SDLPOP_MANUAL_ITEM(level, hashLevel) \
+  SDLPOP_ITEM(checkpoint, PER_FRAME_STATE) \
+  SDLPOP_ITEM(upside_down, PER_FRAME_STATE) \
+  SDLPOP_ITEM(drawn_room, HASHABLE) \
+  SDLPOP_ITEM(current_level, PER_FRAME_STATE) \
+  SDLPOP_ITEM(next_level, PER_FRAME_STATE) \
+  SDLPOP_MANUAL_ITEM(mobs_count, hashMobsCount) \
+  SDLPOP_MANUAL_ITEM(mobs, hashMobs) \
+  SDLPOP_MANUAL_ITEM(trobs_count, hashTrobsCount) \
+  SDLPOP_MANUAL_ITEM(trobs, hashTrobs) \
+  SDLPOP_ITEM(leveldoor_open, HASHABLE) \
+  SDLPOP_ITEM(Kid, HASHABLE) \
+  SDLPOP_ITEM(hitp_curr, PER_FRAME_STATE) \
+  SDLPOP_ITEM(hitp_max, PER_FRAME_STATE) \
+  SDLPOP_ITEM(hitp_beg_lev, PER_FRAME_STATE) \
+  SDLPOP_ITEM(grab_timer, HASHABLE) \
+  SDLPOP_ITEM(holding_sword, HASHABLE) \
+  SDLPOP_ITEM(united_with_shadow, HASHABLE) \
+  SDLPOP_ITEM(have_sword, HASHABLE) \
+  /*SDLPOP_ITEM(ctrl1_forward, HASHABLE) \
+  SDLPOP_ITEM(ctrl1_backward, HASHABLE) \
+  SDLPOP_ITEM(ctrl1_up, HASHABLE) \
+  SDLPOP_ITEM(ctrl1_down, HASHABLE) \
+  SDLPOP_ITEM(ctrl1_shift2, HASHABLE)*/ \
+  SDLPOP_ITEM(kid_sword_strike, HASHABLE) \
+  SDLPOP_ITEM(pickup_obj_type, HASHABLE) \
+  SDLPOP_ITEM(offguard, HASHABLE) \
+  /* guard */ \
+  SDLPOP_ITEM(Guard, PER_FRAME_STATE) \
+  SDLPOP_ITEM(Char, PER_FRAME_STATE) \
+  SDLPOP_ITEM(Opp, PER_FRAME_STATE) \
+  SDLPOP_ITEM(guardhp_curr, PER_FRAME_STATE) \
+  SDLPOP_ITEM(guardhp_max, PER_FRAME_STATE) \
+  SDLPOP_ITEM(demo_index, PER_FRAME_STATE) \
+  SDLPOP_ITEM(demo_time, PER_FRAME_STATE) \
+  SDLPOP_ITEM(curr_guard_color, PER_FRAME_STATE) \
+  SDLPOP_ITEM(guard_notice_timer, HASHABLE) \
+  SDLPOP_ITEM(guard_skill, PER_FRAME_STATE) \
+  SDLPOP_ITEM(shadow_initialized, PER_FRAME_STATE) \
+  SDLPOP_ITEM(guard_refrac, HASHABLE) \
+  SDLPOP_ITEM(justblocked, HASHABLE) \
+  SDLPOP_ITEM(droppedout, HASHABLE) \
+  /* collision */ \
+  SDLPOP_ITEM(curr_row_coll_room, PER_FRAME_STATE) \
+  SDLPOP_ITEM(curr_row_coll_flags, PER_FRAME_STATE) \
+  SDLPOP_ITEM(below_row_coll_room, PER_FRAME_STATE) \
+  SDLPOP_ITEM(below_row_coll_flags, PER_FRAME_STATE) \
+  SDLPOP_ITEM(above_row_coll_room, PER_FRAME_STATE) \
+  SDLPOP_ITEM(above_row_coll_flags, PER_FRAME_STATE) \
+  SDLPOP_ITEM(prev_collision_row, PER_FRAME_STATE) \
+  /* flash */ \
+  SDLPOP_ITEM(flash_color, PER_FRAME_STATE) \
+  SDLPOP_ITEM(flash_time, PER_FRAME_STATE) \
+  /* sounds */ \
+  SDLPOP_ITEM(need_level1_music, HASHABLE) \
+  SDLPOP_ITEM(is_screaming, HASHABLE) \
+  SDLPOP_ITEM(is_feather_fall, HASHABLE) \
+  SDLPOP_ITEM(last_loose_sound, HASHABLE) \
+  /* SDLPOP_ITEM(next_sound, HASHABLE) */ \
+  /* SDLPOP_ITEM(current_sound, HASHABLE) */ \
+  /* random */ \
+  SDLPOP_ITEM(random_seed, PER_FRAME_STATE) \
+  /* remaining time */ \
+  SDLPOP_ITEM(rem_min, PER_FRAME_STATE) \
+  SDLPOP_ITEM(rem_tick, PER_FRAME_STATE) \
+  /* saved controls */ \
+  SDLPOP_ITEM(control_x, PER_FRAME_STATE) \
+  SDLPOP_ITEM(control_y, PER_FRAME_STATE) \
+  SDLPOP_ITEM(control_shift, PER_FRAME_STATE) \
+  SDLPOP_ITEM(control_forward, PER_FRAME_STATE) \
+  SDLPOP_ITEM(control_backward, PER_FRAME_STATE) \
+  SDLPOP_ITEM(control_up, PER_FRAME_STATE) \
+  SDLPOP_ITEM(control_down, PER_FRAME_STATE) \
+  SDLPOP_ITEM(control_shift2, PER_FRAME_STATE) \
+  SDLPOP_ITEM(ctrl1_forward, PER_FRAME_STATE) \
+  SDLPOP_ITEM(ctrl1_backward, PER_FRAME_STATE) \
+  SDLPOP_ITEM(ctrl1_up, PER_FRAME_STATE) \
+  SDLPOP_ITEM(ctrl1_down, PER_FRAME_STATE) \
+  SDLPOP_ITEM(ctrl1_shift2, PER_FRAME_STATE) \
+  /* Support for overflow glitch */ \
+  SDLPOP_ITEM(exit_room_timer, PER_FRAME_STATE) \
+  /* replay recording state */ \
+  INSTANCE_ITEM(replay_curr_tick, PER_FRAME_STATE) \
+  SDLPOP_ITEM(is_guard_notice, PER_FRAME_STATE) \
+  SDLPOP_ITEM(can_guard_see_kid, PER_FRAME_STATE)
+
+// Plain struct with the frame data layout, generated from the state schema. Field types are taken from the
+// instance: the pointed-to type for SDLPop items and the member type for instance items.
+#pragma pack(push, 1)
+struct StateData
+{
+  #define STATE_DATA_SDLPOP_FIELD(NAME, ARG) std::remove_pointer_t<decltype(SDLPopInstance::NAME)> NAME;
+  #define STATE_DATA_INSTANCE_FIELD(NAME, ARG) decltype(SDLPopInstance::NAME) NAME;
+  STATE_ITEMS(STATE_DATA_SDLPOP_FIELD, STATE_DATA_SDLPOP_FIELD, STATE_DATA_INSTANCE_FIELD)
+  #undef STATE_DATA_SDLPOP_FIELD
+  #undef STATE_DATA_INSTANCE_FIELD
+};
+#pragma pack(pop)
+
+static_assert(sizeof(StateData) == _FRAME_DATA_SIZE, "StateData size does not match _FRAME_DATA_SIZE");
@@ -5,7 +5,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 std::vector<std::string> split(const std::string &s, char delim)
 {
@@ -63,12 +66,12 @@ bool loadStringFromFile(std::string &dst, const char *fileName)
 }
 
 // Save string to a file
-bool saveStringToFile(const std::string &src, const char *fileName)
+bool saveStringToFile(const std::string_view src, const char *fileName)
 {
   FILE *fid = fopen(fileName, "w");
   if (fid != NULL)
   {
-    fwrite(src.c_str(), 1, src.size(), fid);
+    fwrite(src.data(), 1, src.size(), fid);
     fclose(fid);
     return true;
   }
@@ -82,3 +85,283 @@ std::string slurp(std::ifstream &in)
   sstr << in.rdbuf();
   return sstr.str();
 }
+
+// Codec format: a sequence of [token][extra literal length][literals][match offset][extra match length],
+// where the token holds the literal length (high nibble) and the match length minus 4 (low nibble).
+// A nibble value of 15 means the length continues in the following bytes (255 means keep reading).
+// The last sequence only has literals.
+
+#define _CODEC_MIN_MATCH 4
+#define _CODEC_HASH_BITS 12
+#define _CODEC_MAX_OFFSET 65535
+
+static inline uint32_t codecRead32(const char *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t codecHash(const uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - _CODEC_HASH_BITS);
+}
+
+static inline void codecWriteLength(std::string &dst, size_t length)
+{
+  while (length >= 255)
+  {
+    dst.push_back(char(255));
+    length -= 255;
+  }
+  dst.push_back(char(length));
+}
+
+static inline void codecWriteSequence(std::string &dst, const char *literals, const size_t literalLength, const size_t offset, const size_t matchLength)
+{
+  const size_t matchCode = matchLength > 0 ? matchLength - _CODEC_MIN_MATCH : 0;
+  uint8_t token = uint8_t((std::min(literalLength, (size_t)15) << 4) | std::min(matchCode, (size_t)15));
+  dst.push_back(char(token));
+  if (literalLength >= 15) codecWriteLength(dst, literalLength - 15);
+  dst.append(literals, literalLength);
+
+  if (matchLength == 0) return;
+  dst.push_back(char(offset & 0xFF));
+  dst.push_back(char(offset >> 8));
+  if (matchCode >= 15) codecWriteLength(dst, matchCode - 15);
+}
+
+size_t compressBound(const size_t size)
+{
+  return size + size / 255 + 16;
+}
+
+void compressBuffer(const char *src, const size_t srcSize, std::string &dst)
+{
+  dst.clear();
+  dst.reserve(compressBound(srcSize));
+
+  std::vector<uint32_t> table(1 << _CODEC_HASH_BITS, UINT32_MAX);
+  size_t pos = 0;
+  size_t anchor = 0;
+
+  while (pos + _CODEC_MIN_MATCH <= srcSize)
+  {
+    const uint32_t sequence = codecRead32(src + pos);
+    const uint32_t h = codecHash(sequence);
+    const uint32_t candidate = table[h];
+    table[h] = pos;
+
+    if (candidate == UINT32_MAX || pos - candidate > _CODEC_MAX_OFFSET || codecRead32(src + candidate) != sequence)
+    {
+      pos++;
+      continue;
+    }
+
+    // Extending the match as far as possible
+    size_t matchLength = _CODEC_MIN_MATCH;
+    while (pos + matchLength < srcSize && src[candidate + matchLength] == src[pos + matchLength]) matchLength++;
+
+    codecWriteSequence(dst, src + anchor, pos - anchor, pos - candidate, matchLength);
+    pos += matchLength;
+    anchor = pos;
+  }
+
+  // Remaining literals
+  codecWriteSequence(dst, src + anchor, srcSize - anchor, 0, 0);
+}
+
+static inline bool codecReadLength(const uint8_t *&p, const uint8_t *end, size_t &length)
+{
+  uint8_t b;
+  do
+  {
+    if (p >= end) return false;
+    b = *p++;
+    length += b;
+  } while (b == 255);
+  return true;
+}
+
+bool decompressBuffer(const char *src, const size_t srcSize, char *dst, const size_t dstSize)
+{
+  const uint8_t *p = (const uint8_t *)src;
+  const uint8_t *end = p + srcSize;
+  size_t outPos = 0;
+
+  while (p < end)
+  {
+    const uint8_t token = *p++;
+
+    // Literals
+    size_t literalLength = token >> 4;
+    if (literalLength == 15 && codecReadLength(p, end, literalLength) == false) return false;
+    if ((size_t)(end - p) < literalLength || dstSize - outPos < literalLength) return false;
+    memcpy(dst + outPos, p, literalLength);
+    p += literalLength;
+    outPos += literalLength;
+
+    // The last sequence has no match
+    if (p == end) break;
+
+    // Match
+    if (end - p < 2) return false;
+    const size_t offset = size_t(p[0]) | (size_t(p[1]) << 8);
+    p += 2;
+    size_t matchLength = token & 0x0F;
+    if (matchLength == 15 && codecReadLength(p, end, matchLength) == false) return false;
+    matchLength += _CODEC_MIN_MATCH;
+
+    if (offset == 0 || offset > outPos || dstSize - outPos < matchLength) return false;
+    for (size_t i = 0; i < matchLength; i++, outPos++) dst[outPos] = dst[outPos - offset];
+  }
+
+  return outPos == dstSize;
+}
+
+// State container layout: [header][compressed records][index entries][entry count][index magic]
+
+bool isStateFile(const char *fileName)
+{
+  FILE *fid = fopen(fileName, "rb");
+  if (fid == NULL) return false;
+
+  char magic[8];
+  bool isContainer = fread(magic, 1, sizeof(magic), fid) == sizeof(magic) && memcmp(magic, _STATE_FILE_MAGIC, sizeof(magic)) == 0;
+  fclose(fid);
+  return isContainer;
+}
+
+StateFileWriter::StateFileWriter(const char *fileName, const uint32_t schemaVersion, const uint64_t layoutHash, const uint32_t levelId, const uint32_t recordSize)
+{
+  _file = fopen(fileName, "wb");
+  if (_file == NULL) EXIT_WITH_ERROR("[Error] Could not open state file for writing: %s\n", fileName);
+
+  memset(&_header, 0, sizeof(_header));
+  memcpy(_header.magic, _STATE_FILE_MAGIC, sizeof(_header.magic));
+  _header.formatVersion = _STATE_FILE_FORMAT_VERSION;
+  _header.schemaVersion = schemaVersion;
+  _header.layoutHash = layoutHash;
+  _header.levelId = levelId;
+  _header.recordSize = recordSize;
+
+  if (fwrite(&_header, sizeof(_header), 1, _file) != 1) EXIT_WITH_ERROR("[Error] Could not write state file header: %s\n", fileName);
+}
+
+StateFileWriter::~StateFileWriter()
+{
+  // Destructors cannot throw, so errors are only reported here. Call close() to handle them
+  try
+  {
+    close();
+  }
+  catch (const std::runtime_error &err)
+  {
+    fprintf(stderr, "%s", err.what());
+  }
+}
+
+void StateFileWriter::add(const std::string_view record, const uint64_t hash)
+{
+  if (_file == NULL) EXIT_WITH_ERROR("[Error] Adding a record to a closed state file.\n");
+  if (record.size() > _header.recordSize)
+    EXIT_WITH_ERROR("[Error] Wrong record size. Expected at most %u, got: %lu\n", _header.recordSize, record.size());
+
+  compressBuffer(record.data(), record.size(), _compressed);
+
+  StateFileIndexEntry entry;
+  entry.offset = ftell(_file);
+  entry.hash = hash;
+  entry.compressedSize = _compressed.size();
+  entry.rawSize = record.size();
+  _index.push_back(entry);
+
+  if (fwrite(_compressed.data(), 1, _compressed.size(), _file) != _compressed.size()) EXIT_WITH_ERROR("[Error] Could not write state file record.\n");
+}
+
+void StateFileWriter::close()
+{
+  if (_file == NULL) return;
+
+  FILE *file = _file;
+  _file = NULL;
+
+  const uint64_t entryCount = _index.size();
+  bool success = fwrite(_index.data(), sizeof(StateFileIndexEntry), _index.size(), file) == _index.size();
+  success = success && fwrite(&entryCount, sizeof(entryCount), 1, file) == 1;
+  success = success && fwrite(_STATE_FILE_INDEX_MAGIC, 1, 8, file) == 8;
+  // fclose flushes the buffered writes, so its failure also means the file is incomplete
+  success = (fclose(file) == 0) && success;
+
+  if (success == false) EXIT_WITH_ERROR("[Error] Could not write state file index.\n");
+}
+
+StateFileReader::StateFileReader(const char *fileName)
+{
+  _file = fopen(fileName, "rb");
+  if (_file == NULL) EXIT_WITH_ERROR("[Error] Could not open state file: %s\n", fileName);
+
+  if (fread(&_header, sizeof(_header), 1, _file) != 1 || memcmp(_header.magic, _STATE_FILE_MAGIC, sizeof(_header.magic)) != 0)
+    EXIT_WITH_ERROR("[Error] Not a state file: %s\n", fileName);
+
+  if (_header.formatVersion != _STATE_FILE_FORMAT_VERSION)
+    EXIT_WITH_ERROR("[Error] Unsupported state file format version %u (expected %u): %s\n", _header.formatVersion, _STATE_FILE_FORMAT_VERSION, fileName);
+
+  // Reading the trailer and the index before it
+  uint64_t entryCount;
+  char indexMagic[8];
+  const uint64_t trailerSize = sizeof(entryCount) + sizeof(indexMagic);
+  long fileSize;
+  if (fseek(_file, 0, SEEK_END) != 0 || (fileSize = ftell(_file)) < (long)(sizeof(_header) + trailerSize) ||
+      fseek(_file, -(long)trailerSize, SEEK_END) != 0 ||
+      fread(&entryCount, sizeof(entryCount), 1, _file) != 1 ||
+      fread(indexMagic, 1, sizeof(indexMagic), _file) != sizeof(indexMagic) ||
+      memcmp(indexMagic, _STATE_FILE_INDEX_MAGIC, sizeof(indexMagic)) != 0)
+    EXIT_WITH_ERROR("[Error] State file has no index (was it closed properly?): %s\n", fileName);
+
+  // The index must fit between the header and the trailer. Checking the count first keeps the size product from overflowing
+  const uint64_t maxIndexSize = fileSize - sizeof(_header) - trailerSize;
+  if (entryCount > maxIndexSize / sizeof(StateFileIndexEntry))
+    EXIT_WITH_ERROR("[Error] State file index has %lu entries, more than the file can hold: %s\n", entryCount, fileName);
+
+  _dataEnd = fileSize - trailerSize - entryCount * sizeof(StateFileIndexEntry);
+  _index.resize(entryCount);
+  if (fseek(_file, _dataEnd, SEEK_SET) != 0 || fread(_index.data(), sizeof(StateFileIndexEntry), entryCount, _file) != entryCount)
+    EXIT_WITH_ERROR("[Error] Could not read state file index: %s\n", fileName);
+
+  // Indexing records by hash, keeping the first occurrence
+  for (size_t i = 0; i < _index.size(); i++) _hashIndex.emplace(_index[i].hash, i);
+}
+
+StateFileReader::~StateFileReader()
+{
+  fclose(_file);
+}
+
+void StateFileReader::get(const size_t ordinal, std::string &record) const
+{
+  if (ordinal >= _index.size()) EXIT_WITH_ERROR("[Error] Requested state %lu, but the file only contains %lu.\n", ordinal, _index.size());
+
+  // Positioned reads into a local buffer leave no shared file offset or scratch space behind
+  const auto &entry = _index[ordinal];
+  if (entry.offset < sizeof(_header) || entry.offset > _dataEnd || entry.compressedSize > _dataEnd - entry.offset)
+    EXIT_WITH_ERROR("[Error] State %lu lies outside the state file records.\n", ordinal);
+  if (entry.rawSize > _header.recordSize)
+    EXIT_WITH_ERROR("[Error] State %lu has size %u, more than the file record size %u.\n", ordinal, entry.rawSize, _header.recordSize);
+
+  std::string compressed(entry.compressedSize, '\0');
+  if (pread(fileno(_file), &compressed[0], entry.compressedSize, entry.offset) != (ssize_t)entry.compressedSize)
+    EXIT_WITH_ERROR("[Error] Could not read state %lu from file.\n", ordinal);
+
+  record.resize(entry.rawSize);
+  if (decompressBuffer(compressed.data(), compressed.size(), &record[0], entry.rawSize) == false)
+    EXIT_WITH_ERROR("[Error] State %lu is corrupted.\n", ordinal);
+}
+
+bool StateFileReader::find(const uint64_t hash, size_t &ordinal) const
+{
+  auto it = _hashIndex.find(hash);
+  if (it == _hashIndex.end()) return false;
+  ordinal = it->second;
+  return true;
+}
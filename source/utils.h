@@ -1,9 +1,13 @@
 #pragma once
 
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
 #include <iterator>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 // Function to split a string into a sub-strings delimited by a character
@@ -36,7 +40,7 @@ bool dirExists(const std::string dirPath);
 bool loadStringFromFile(std::string &dst, const char *fileName);
 
 // Save string to a file
-bool saveStringToFile(const std::string &dst, const char *fileName);
+bool saveStringToFile(const std::string_view src, const char *fileName);
 
 #pragma GCC diagnostic ignored "-Wparentheses"
 
@@ -68,3 +72,82 @@ std::vector<T> splitVector(const T size, const T n)
 
 // Taken from https://stackoverflow.com/questions/116038/how-do-i-read-an-entire-file-into-a-stdstring-in-c/116220#116220
 std::string slurp(std::ifstream &in);
+
+// Fast LZ77-style codec for state data. Compressed data can be up to compressBound(size) bytes long
+size_t compressBound(const size_t size);
+void compressBuffer(const char *src, const size_t srcSize, std::string &dst);
+bool decompressBuffer(const char *src, const size_t srcSize, char *dst, const size_t dstSize);
+
+// Container file for many compressed savestates, with an index for random access by ordinal or hash
+#define _STATE_FILE_MAGIC "JAFFARSV"
+#define _STATE_FILE_INDEX_MAGIC "JAFFARIX"
+#define _STATE_FILE_FORMAT_VERSION 1
+
+struct StateFileHeader
+{
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t schemaVersion;
+  uint64_t layoutHash;
+  uint32_t levelId;
+  uint32_t recordSize;
+};
+
+struct StateFileIndexEntry
+{
+  uint64_t offset;
+  uint64_t hash;
+  uint32_t compressedSize;
+  uint32_t rawSize;
+};
+
+// Checks whether the given file is a state container
+bool isStateFile(const char *fileName);
+
+// Writes records as they are added. The index is appended when the writer is closed
+class StateFileWriter
+{
+  public:
+  StateFileWriter(const char *fileName, const uint32_t schemaVersion, const uint64_t layoutHash, const uint32_t levelId, const uint32_t recordSize);
+  ~StateFileWriter();
+
+  // Adds a record of up to recordSize bytes, identified by the given hash
+  void add(const std::string_view record, const uint64_t hash);
+
+  // Writes the index and closes the file
+  void close();
+
+  size_t size() const { return _index.size(); }
+
+  private:
+  FILE *_file;
+  StateFileHeader _header;
+  std::vector<StateFileIndexEntry> _index;
+  std::string _compressed;
+};
+
+// Reads the header and index upon opening, and records on request
+class StateFileReader
+{
+  public:
+  StateFileReader(const char *fileName);
+  ~StateFileReader();
+
+  const StateFileHeader &getHeader() const { return _header; }
+  size_t size() const { return _index.size(); }
+
+  // Reads the record at the given ordinal. Safe to call from several threads at once, as is find()
+  void get(const size_t ordinal, std::string &record) const;
+
+  // Finds the ordinal of the first record with the given hash. Returns false if not found
+  bool find(const uint64_t hash, size_t &ordinal) const;
+
+  private:
+  FILE *_file;
+  StateFileHeader _header;
+  std::vector<StateFileIndexEntry> _index;
+  std::unordered_map<uint64_t, size_t> _hashIndex;
+
+  // Records end where the index starts
+  uint64_t _dataEnd;
+};
@@ -0,0 +1,208 @@
+#include "argparse.hpp"
+#include "batch.h"
+#include "common.h"
+#include "frameStore.h"
+#include "hash.h"
+#include "stateArena.h"
+#include "state.h"
+#include "utils.h"
+#include <chrono>
+#include <cstring>
+
+int main(int argc, char *argv[])
+{
+  // Defining arguments
+  argparse::ArgumentParser program("jaffar-verify", JAFFAR_VERSION);
+
+  program.add_argument("savFile")
+    .help("Specifies the path to the SDLPop savefile (.sav) from which to start.")
+    .required();
+
+  program.add_argument("solutionFile")
+    .help("path to the Jaffar solution (.sol or .solb) file to run.")
+    .required();
+
+  program.add_argument("--headlessReference")
+    .help("Compares against an instance initialized without GUI, instead of with it.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--batchInstances")
+    .help("Number of simulation-only instances checking every transition of the reference run in parallel.")
+    .default_value(std::string("4"));
+
+  // Parsing command line
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error &err)
+  {
+    fprintf(stderr, "[Jaffar] Error parsing command line arguments: %s\n%s", err.what(), program.help().str().c_str());
+    exit(-1);
+  }
+
+  // Getting arguments
+  std::string saveFilePath = program.get<std::string>("savFile");
+  std::string solutionFile = program.get<std::string>("solutionFile");
+  bool isHeadlessReference = program.get<bool>("--headlessReference");
+  const size_t batchInstances = std::stoul(program.get<std::string>("--batchInstances"));
+
+  // Loading solution file
+  std::vector<Move> moveList;
+  bool status = loadSolutionFile(moveList, solutionFile.c_str());
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not find or read from solution file: %s\n", solutionFile.c_str());
+
+  // Initializing the reference SDLPop Instance, through the regular (GUI) path, loading every level from file
+  SDLPopInstance refSDLPop("libsdlPopLib.so", false);
+  refSDLPop.setLevelCache(false);
+  refSDLPop.initialize(isHeadlessReference == false);
+
+  // Initializing the simulation-only SDLPop Instance (with level cache), in its own library namespace
+  SDLPopInstance simSDLPop("libsdlPopLib.so", true);
+  simSDLPop.initialize(false, true);
+
+  // Loading save file contents
+  std::string saveString;
+  status = State::loadFrameFromFile(refSDLPop, saveFilePath.c_str(), 0, saveString);
+  if (status == false) EXIT_WITH_ERROR("[ERROR] Could not load save state from file: %s\n", saveFilePath.c_str());
+
+  // Initializing State Handlers
+  State refState(&refSDLPop, saveString);
+  State simState(&simSDLPop, saveString);
+  const auto &items = refState.getItems();
+
+  printf("[Jaffar] Verifying simulation-only mode against the %s path over %lu moves...\n", isHeadlessReference ? "headless" : "GUI", moveList.size());
+
+  // Running the reference instance over the whole solution, keeping the hash and contents of every frame,
+  // and counting level starts and restarts along the way
+  std::vector<uint64_t> refHashes;
+  FrameStore refFrames(64);
+  StateArena frameArena;
+  char *refFrame = frameArena.getSlot(frameArena.allocate());
+  char *simFrame = frameArena.getSlot(frameArena.allocate());
+  size_t levelStarts = 0;
+  word prevLevel = *refSDLPop.current_level;
+  refState.saveState(refFrame);
+  const std::string initialFrame(refFrame, _FRAME_DATA_SIZE);
+  auto t0 = std::chrono::high_resolution_clock::now();
+  refSDLPop.advanceFrames(moveList.data(), moveList.size(), 1, [&](const size_t moveId) {
+    refHashes.push_back(refState.computeHash());
+    refState.saveState(refFrame);
+    refFrames.push(std::string_view(refFrame, _FRAME_DATA_SIZE));
+    if (*refSDLPop.current_level != prevLevel || (moveList[moveId] & MOVE_RESTART)) levelStarts++;
+    prevLevel = *refSDLPop.current_level;
+    return true;
+  });
+  auto t1 = std::chrono::high_resolution_clock::now();
+
+  // Running the simulation-only instance, stopping at the first mismatch
+  size_t mismatchId = moveList.size();
+  auto t2 = std::chrono::high_resolution_clock::now();
+  simSDLPop.advanceFrames(moveList.data(), moveList.size(), 1, [&](const size_t moveId) {
+    if (simState.computeHash() == refHashes[moveId]) return true;
+    mismatchId = moveId;
+    return false;
+  });
+  auto t3 = std::chrono::high_resolution_clock::now();
+
+  // Reports the items that differ between the expected frame and the one obtained after a given move
+  auto reportMismatch = [&](const char *check, const size_t moveId, const char *expectedFrame, const char *frame) {
+    printf("[Jaffar] %s mismatch after move %lu (%s):\n", check, moveId, moveToString(moveList[moveId]).c_str());
+    for (const auto &item : items)
+      if (memcmp(&expectedFrame[item.offset], &frame[item.offset], item.size) != 0) printf("[Jaffar]  + %s\n", item.name);
+  };
+
+  if (mismatchId < moveList.size())
+  {
+    refFrames.get(mismatchId, refFrame);
+    simState.saveState(simFrame);
+    reportMismatch("State", mismatchId, refFrame, simFrame);
+    exit(-1);
+  }
+
+  // Checking every transition of the reference run through the batch API, the way solvers step: each step loads
+  // the reference frame before a move and must reach the reference frame after it. The continuous run above is
+  // still needed, since batch steps load every frame and so never carry the simulation-only state across frames
+  printf("[Jaffar] Verifying every transition through a batch of %lu simulation-only instances...\n", batchInstances);
+  StateBatch batch("libsdlPopLib.so", batchInstances, saveString, true);
+  const size_t batchSize = 4096;
+  std::vector<char *> sourceFrames(batchSize);
+  std::vector<char *> resultFrames(batchSize);
+  for (size_t i = 0; i < batchSize; i++)
+  {
+    sourceFrames[i] = frameArena.getSlot(frameArena.allocate());
+    resultFrames[i] = frameArena.getSlot(frameArena.allocate());
+  }
+
+  std::vector<StateBatch::Step> steps;
+  for (size_t firstId = 0; firstId < moveList.size(); firstId += batchSize)
+  {
+    steps.resize(std::min(batchSize, moveList.size() - firstId));
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+      const size_t moveId = firstId + i;
+      if (moveId == 0) memcpy(sourceFrames[i], initialFrame.data(), _FRAME_DATA_SIZE);
+      if (moveId > 0) refFrames.get(moveId - 1, sourceFrames[i]);
+      steps[i] = {std::string_view(sourceFrames[i], _FRAME_DATA_SIZE), moveList[moveId], resultFrames[i], 0};
+    }
+
+    batch.run(steps);
+
+    for (size_t i = 0; i < steps.size(); i++)
+      if (steps[i].resultHash != refHashes[firstId + i])
+      {
+        refFrames.get(firstId + i, refFrame);
+        reportMismatch("Batch step", firstId + i, refFrame, steps[i].resultData);
+        exit(-1);
+      }
+  }
+
+  // Checking the level cache on its own: two regular headless instances, one starting levels from the levels file
+  // and the other from the cache, must agree on the full state (every item, hashed or not) and on the room links
+  // that load_level() leaves behind, on every frame
+  printf("[Jaffar] Verifying the level cache against loading levels from file...\n");
+  SDLPopInstance fileSDLPop("libsdlPopLib.so", true);
+  fileSDLPop.setLevelCache(false);
+  fileSDLPop.initialize(false);
+  SDLPopInstance cacheSDLPop("libsdlPopLib.so", true);
+  cacheSDLPop.initialize(false);
+  State fileState(&fileSDLPop, saveString);
+  State cacheState(&cacheSDLPop, saveString);
+
+  auto getFullHash = [&](SDLPopInstance &sdlPop, State &state, char *frame) {
+    state.saveState(frame);
+    const word roomLinks[2] = {*sdlPop.room_L, *sdlPop.room_R};
+    return hashBuffer(roomLinks, sizeof(roomLinks), hashBuffer(frame, _FRAME_DATA_SIZE));
+  };
+
+  std::vector<uint64_t> fileHashes;
+  FrameStore fileFrames(64);
+  fileSDLPop.advanceFrames(moveList.data(), moveList.size(), 1, [&](const size_t) {
+    fileHashes.push_back(getFullHash(fileSDLPop, fileState, refFrame));
+    fileFrames.push(std::string_view(refFrame, _FRAME_DATA_SIZE));
+    return true;
+  });
+
+  cacheSDLPop.advanceFrames(moveList.data(), moveList.size(), 1, [&](const size_t moveId) {
+    if (getFullHash(cacheSDLPop, cacheState, simFrame) == fileHashes[moveId]) return true;
+    mismatchId = moveId;
+    return false;
+  });
+
+  if (mismatchId < moveList.size())
+  {
+    fileFrames.get(mismatchId, refFrame);
+    reportMismatch("Level cache", mismatchId, refFrame, simFrame);
+    printf("[Jaffar] If no items are listed, the room links differ.\n");
+    exit(-1);
+  }
+
+  const double refSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() * 1.0e-9;
+  const double simSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count() * 1.0e-9;
+
+  printf("[Jaffar] States match on every frame (%lu level starts/restarts), and so do full states with and without the level cache.\n", levelStarts);
+  printf("[Jaffar] Reference:        %12.0f frames/s (including frame storage)\n", (double)moveList.size() / refSeconds);
+  printf("[Jaffar] Simulation-only:  %12.0f frames/s (%.2fx)\n", (double)moveList.size() / simSeconds, refSeconds / simSeconds);
+  printf("[Jaffar] Batch (%3lu inst.): %12.0f frames/s (including state loads)\n", batch.getInstanceCount(), batch.getFramesPerSecond());
+}